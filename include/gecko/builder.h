@@ -0,0 +1,54 @@
+// Copyright (c) 2019-2020, Lawrence Livermore National Security, LLC and other
+// gecko project contributors. See the top-level LICENSE file for details.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef GECKO_BUILDER_H
+#define GECKO_BUILDER_H
+
+#include <cstddef>
+#include <vector>
+#include "gecko/types.h"
+#include "gecko/graph.h"
+
+namespace Gecko {
+
+// Graph construction from undirected edges given in arbitrary order.
+template <typename I>
+class BasicGraphBuilder {
+public:
+  typedef BasicGraph<I> Graph;
+  typedef typename Graph::Arc Arc;
+  typedef typename Graph::Node Node;
+
+  // constructor of builder for graph with given (minimum) number of nodes;
+  // weights of duplicate edges are summed if accumulate is true and
+  // otherwise the largest weight is kept
+  BasicGraphBuilder(I nodes = 0, bool accumulate = false) : count(nodes), accumulate(accumulate) {}
+
+  // number of nodes and (possibly duplicate) edges inserted so far
+  I nodes() const { return count; }
+  size_t edges() const { return head.size(); }
+
+  // reserve space for given number of edges
+  void reserve(size_t edges);
+
+  // insert undirected edge {i, j} in any order and return success
+  bool insert_edge(typename Node::Index i, typename Node::Index j, Float w = 1);
+
+  // assemble graph with both arcs (i, j) and (j, i) for each distinct edge,
+  // replacing any prior contents of graph, and reset builder
+  bool build(Graph& graph);
+
+private:
+  I count;                                // number of nodes
+  bool accumulate;                        // sum weights of duplicate edges?
+  std::vector<typename Node::Index> head; // first node of each edge
+  std::vector<typename Node::Index> tail; // second node of each edge
+  std::vector<Float> weight;              // weight of each edge
+};
+
+typedef BasicGraphBuilder<uint32_t> GraphBuilder;
+
+}
+
+#endif
@@ -6,13 +6,12 @@
 
 namespace Gecko {
 
-class Graph;
-
 // 2D graph drawing
 class Drawing {
 public:
   Drawing(Device* d) : device(d) {}
-  void draw(const Graph* g);
+  template <typename I>
+  void draw(const BasicGraph<I>* g);
 private:
   Device* device;
 };
@@ -54,6 +54,13 @@ public:
     s.weight += t.weight;
   }
 
+  // add unit-weight term with value l to weighted sum; overrides must
+  // agree with sum()
+  virtual void accumulate(WeightedSum& s, Float l) const
+  {
+    accumulate(s, WeightedValue(l, 1));
+  }
+
   // is s potentially less than t?
   virtual bool less(const WeightedSum& s, const WeightedSum& t) const
   {
@@ -6,6 +6,8 @@
 #define GECKO_GRAPH_H
 
 #include <cmath>
+#include <cstddef>
+#include <limits>
 #include <string>
 #include <utility>
 #include <vector>
@@ -15,118 +17,179 @@
 
 namespace Gecko {
 
+template <typename I> class Arena;
+template <typename I, uint N, class F> class Subgraph;
+
 // Multilevel graph arc.
-class Arc {
+template <typename I>
+class BasicArc {
+public:
+  typedef I Index;
+  typedef typename std::vector<Index>::const_iterator ConstPtr;
+  enum { null = 0 };
+};
+
+// Multilevel graph edge, i.e., pair of arcs sharing weight and bond.
+template <typename I>
+class BasicEdge {
 public:
-  typedef uint Index;
-  typedef std::vector<Index>::const_iterator ConstPtr;
+  typedef I Index;
   enum { null = 0 };
 };
 
-// Multilevel graph node.
-class Node {
+// Multilevel graph node.  Node attributes are stored by the graph as
+// separate arrays.
+template <typename I>
+class BasicNode {
 public:
-  typedef uint Index;
-  typedef std::vector<Node>::const_iterator ConstPtr;
+  typedef I Index;
+  typedef std::vector<Float>::const_iterator ConstPtr;
   enum { null = 0 };
 
-  // comparator for sorting node indices
+  // comparator for sorting node indices by position
   class Comparator {
   public:
-    Comparator(ConstPtr node) : _node(node) {}
-    bool operator()(uint k, uint l) const { return _node[k].pos < _node[l].pos; }
+    Comparator(ConstPtr pos) : _pos(pos) {}
+    bool operator()(Index k, Index l) const { return _pos[k] < _pos[l]; }
   private:
-    const ConstPtr _node;
+    const ConstPtr _pos;
   };
+};
 
-  // constructor
-  Node(Float pos = -1, Float length = 1, Arc::Index arc = Arc::null, Node::Index parent = Node::null) : pos(pos), hlen(Float(0.5) * length), arc(arc), parent(parent) {}
-
-  Float pos;          // start position at full resolution
-  Float hlen;         // half of node length (number of full res nodes)
-  Arc::Index arc;     // one past index of last incident arc
-  Node::Index parent; // parent in next coarser resolution
+// Counts of node relaxations and window optimizations performed and
+// skipped during ordering.  Work is skipped only in converged regions when
+// gecko is built with GECKO_WITH_ACTIVE_SET.
+class Activity {
+public:
+  Activity() : relaxed(0), unrelaxed(0), optimized(0), unoptimized(0) {}
+  size_t relaxed;     // nodes relaxed
+  size_t unrelaxed;   // nodes not relaxed as inactive
+  size_t optimized;   // windows optimized
+  size_t unoptimized; // windows not optimized as inactive
 };
 
-// Multilevel graph.
-class Graph {
+// Multilevel graph with nodes and arcs indexed by unsigned integer type I.
+template <typename I>
+class BasicGraph {
 public:
+  typedef BasicArc<I> Arc;
+  typedef BasicEdge<I> Edge;
+  typedef BasicNode<I> Node;
+  typedef BasicProgress<I> Progress;
+
   // constructor of graph with given (initial) number of nodes
-  Graph(uint nodes = 0) : level(0), last_node(Node::null) { init(nodes); }
+  BasicGraph(I nodes = 0) : arena(0), thread_count(0), level(0), last_node(Node::null), state(1) { init(nodes); }
+
+  // constructor of graph from zero-based compressed sparse row arrays
+  BasicGraph(I nodes, const typename Arc::Index* offset, const typename Node::Index* target, const Float* weight = 0);
+
+  // adopt graph in compressed sparse row format without copying arrays
+  bool adopt(std::vector<typename Arc::Index>& offset, std::vector<typename Node::Index>& target, std::vector<Float>& weight);
 
   // number of nodes and edges
-  uint nodes() const { return uint(node.size() - 1); }
-  uint edges() const { return uint((adj.size() - 1) / 2); }
+  I nodes() const { return I(pos.size() - 1); }
+  I edges() const { return I((adj.size() - 1) / 2); }
 
-  // insert node and return its index
-  Node::Index insert_node(Float length = 1);
+  // insert node and return its index (null if no more nodes can be indexed)
+  typename Node::Index insert_node(Float length = 1);
 
   // outgoing arcs {begin, ..., end-1} originating from node i
-  Arc::Index node_begin(Node::Index i) const { return node[i - 1].arc; }
-  Arc::Index node_end(Node::Index i) const { return node[i].arc; }
+  typename Arc::Index node_begin(typename Node::Index i) const { return offset[i - 1]; }
+  typename Arc::Index node_end(typename Node::Index i) const { return offset[i]; }
 
   // node degree and neighbors
-  uint node_degree(Node::Index i) const { return node_end(i) - node_begin(i); }
-  std::vector<Node::Index> node_neighbors(Node::Index i) const;
+  I node_degree(typename Node::Index i) const { return node_end(i) - node_begin(i); }
+  std::vector<typename Node::Index> node_neighbors(typename Node::Index i) const;
 
   // insert directed edge (i, j)
-  Arc::Index insert_arc(Node::Index i, Node::Index j, Float w = 1, Float b = 1);
+  typename Arc::Index insert_arc(typename Node::Index i, typename Node::Index j, Float w = 1, Float b = 1);
 
   // remove arc or edge
-  bool remove_arc(Arc::Index a);
-  bool remove_arc(Node::Index i, Node::Index j);
-  bool remove_edge(Node::Index i, Node::Index j);
+  bool remove_arc(typename Arc::Index a);
+  bool remove_arc(typename Node::Index i, typename Node::Index j);
+  bool remove_edge(typename Node::Index i, typename Node::Index j);
+
+  // remove multiple arcs or edges (arcs and their reverse arcs) in a
+  // single pass and return the number of arcs removed
+  I remove_arcs(const std::vector<typename Arc::Index>& arcs);
+  I remove_edges(const std::vector<typename Arc::Index>& arcs);
+
+  // remove arcs or edges for which remove(i, j, w) is true
+  template <class Predicate>
+  I remove_arcs(Predicate remove) { return remove_arcs(select(remove)); }
+  template <class Predicate>
+  I remove_edges(Predicate remove) { return remove_edges(select(remove)); }
 
   // index of arc (i, j) or null if not present
-  Arc::Index arc_index(Node::Index i, Node::Index j) const;
+  typename Arc::Index arc_index(typename Node::Index i, typename Node::Index j) const;
 
   // arc source and target nodes and weight
-  Node::Index arc_source(Arc::Index a) const;
-  Node::Index arc_target(Arc::Index a) const { return adj[a]; }
-  Float arc_weight(Arc::Index a) const { return weight[a]; }
+  typename Node::Index arc_source(typename Arc::Index a) const { return shared_weights() ? adj[twin[a]] : source[a]; }
+  typename Node::Index arc_target(typename Arc::Index a) const { return adj[a]; }
+  Float arc_weight(typename Arc::Index a) const { return unit_weights() ? Float(1) : weight[arc_edge(a)]; }
 
   // reverse arc (j, i) of arc a = (i, j)
-  Arc::Index reverse_arc(Arc::Index a) const;
+  typename Arc::Index reverse_arc(typename Arc::Index a) const;
 
   // order graph
   void order(Functional* functional, uint iterations = 1, uint window = 2, uint period = 2, uint seed = 0, Progress* progress = 0);
 
+  // order graph once for each seed, concurrently if possible, keeping the
+  // best ordering, and return the index of its seed along with all costs
+  uint order(Functional* functional, const std::vector<uint>& seeds, std::vector<Float>& costs, uint iterations = 1, uint window = 2, uint period = 2, Progress* progress = 0);
+
   // optimal permutation found
-  const std::vector<Node::Index>& permutation() const { return perm; }
+  const std::vector<typename Node::Index>& permutation() const { return perm; }
 
   // node of given rank in reordered graph (0 <= rank <= nodes() - 1)
-  Node::Index permutation(uint rank) const { return perm[rank]; }
+  typename Node::Index permutation(I rank) const { return perm[rank]; }
 
   // position of node i in reordered graph (1 <= i <= nodes())
-  uint rank(Node::Index i) const { return static_cast<uint>(std::floor(node[i].pos)); }
+  I rank(typename Node::Index i) const { return static_cast<I>(std::floor(pos[i])); }
 
   // cost of current layout
   Float cost() const;
 
+  // work done so far by the current or last call to order()
+  const Activity& activity() const { return tally; }
+
   // return first directed arc if one exists or null otherwise
-  Arc::Index directed() const;
+  typename Arc::Index directed() const;
+
+  // store weights of undirected edges once, shared by both arcs
+  bool share_weights();
+  bool shared_weights() const { return !edge.empty(); }
+
+  // treat all arcs as having unit weight, which requires equal weights
+  bool discard_weights();
+  bool unit_weights() const { return weight.empty(); }
+
+  // number of threads used by order(), with zero selecting the OpenMP
+  // default (has no effect unless gecko is built with OpenMP)
+  void set_threads(uint threads) { thread_count = threads; }
+  uint threads() const { return thread_count; }
 
 protected:
-  friend class Subgraph;
+  template <typename J, uint N, class F> friend class Subgraph;
   friend class Drawing;
 
   // constructor/destructor
-  Graph(uint nodes, uint level) : level(level), last_node(Node::null) { init(nodes); }
+  BasicGraph(I nodes, uint level) : arena(0), thread_count(0), level(level), last_node(Node::null), state(1) { init(nodes); }
 
   // arc length
-  Float length(Node::Index i, Node::Index j) const { return std::fabs(node[i].pos - node[j].pos); }
-  Float length(Arc::Index a) const
+  Float length(typename Node::Index i, typename Node::Index j) const { return std::fabs(pos[i] - pos[j]); }
+  Float length(typename Arc::Index a) const
   {
-    Node::Index i = arc_source(a);
-    Node::Index j = arc_target(a);
+    typename Node::Index i = arc_source(a);
+    typename Node::Index j = arc_target(a);
     return length(i, j);
   }
 
   // coarsen graph
-  Graph* coarsen();
+  BasicGraph* coarsen();
 
   // refine graph
-  void refine(const Graph* graph);
+  void refine(const BasicGraph* graph);
 
   // perform m sweeps of compatible or Gauss-Seidel relaxation
   void relax(bool compatible, uint m = 1);
@@ -138,10 +201,10 @@ protected:
   void place(bool sort = false);
 
   // place nodes {k, ..., k + n - 1} according to their positions
-  void place(bool sort, uint k, uint n);
+  void place(bool sort, I k, I n);
 
   // perform V cycle using n-node window
-  void vcycle(uint n, uint work = 0);
+  void vcycle(uint n, size_t work = 0);
 
   // randomly shuffle nodes
   void shuffle(uint seed = 0);
@@ -149,44 +212,126 @@ protected:
   // recompute arc bonds for iteration i
   void reweight(uint i);
 
-  // compute cost
-  WeightedSum cost(const std::vector<Arc::Index>& subset, Float pos) const;
-
   // node attributes
-  bool persistent(Node::Index i) const { return node[i].parent != Node::null; }
-  bool placed(Node::Index i) const { return node[i].pos >= Float(0); }
-
-  Functional* functional;        // ordering functional
-  Progress* progress;            // progress callbacks
-  std::vector<Node::Index> perm; // ordered list of indices to nodes
-  std::vector<Node> node;        // statically ordered list of nodes
-  std::vector<Node::Index> adj;  // statically ordered list of adjacent nodes
-  std::vector<Float> weight;     // statically ordered list of arc weights
-  std::vector<Float> bond;       // statically ordered list of coarsening weights
+  bool persistent(typename Node::Index i) const { return parent[i] != Node::null; }
+  bool placed(typename Node::Index i) const { return pos[i] >= Float(0); }
+
+  Functional* functional;                   // ordering functional
+  Progress* progress;                       // progress callbacks
+  std::vector<typename Node::Index> perm;   // ordered list of indices to nodes
+  std::vector<Float> pos;                   // statically ordered list of node start positions at full resolution
+  std::vector<Float> hlen;                  // statically ordered list of half node lengths
+  std::vector<typename Arc::Index> offset;  // statically ordered list of one past last arc of each node
+  std::vector<typename Node::Index> parent; // statically ordered list of node parents in coarser graph
+  std::vector<typename Node::Index> adj;    // statically ordered list of adjacent nodes
+  std::vector<typename Node::Index> source; // statically ordered list of arc sources
+  std::vector<typename Arc::Index> twin;    // statically ordered list of reverse arcs
+  std::vector<typename Edge::Index> edge;   // statically ordered list of arc edges
+  std::vector<Float> weight;                // statically ordered list of arc (edge) weights, if any
+  std::vector<Float> bond;                  // statically ordered list of coarsening weights
+  Arena<I>* arena;                          // storage recycled across V-cycles
+  uint thread_count;                        // number of threads (0 = default)
 
 private:
   // initialize graph with given number of nodes
-  void init(uint nodes);
+  void init(I nodes);
+
+  // clear graph for reuse as coarse graph at given level, retaining storage
+  void reset(uint level, bool shared);
+
+  // reserve storage for given number of nodes and arcs
+  void reserve(size_t nodes, size_t arcs);
+
+  // can all entries of an array of given size be indexed by I?
+  static bool indexable(size_t size) { return size - 1 < size_t(std::numeric_limits<I>::max()); }
 
   // find optimal position of node i while fixing all other nodes
-  Float optimal(Node::Index i) const;
+  Float optimal(typename Node::Index i) const;
+
+  // is node i near a change to the layout?
+  bool active(typename Node::Index i) const;
+
+  // activate nodes near changes to the layout since the last V-cycle
+  void activate();
+
+  // mark nodes with arcs whose lengths differ from those given by positions p
+  void touch(std::vector<char>& mark, const std::vector<Float>& p) const;
+
+  // optimize successive windows of N nodes using functional of type F
+  template <class F, uint N>
+  void optimize();
+
+  // optimize window starting at position k unless inactive
+  template <class F, uint N>
+  bool optimize(Subgraph<I, N, F>& subgraph, I k);
+
+  // pair each arc with its reverse arc
+  void twin_arcs();
+
+  // partition nodes into independent sets for parallel relaxation
+  void color();
+
+  // index into weight and bond arrays of arc a
+  typename Arc::Index arc_edge(typename Arc::Index a) const { return shared_weights() ? edge[a] : a; }
+
+  // select nodes of coarse graph and compute interpolation weights
+  void aggregate(BasicGraph* g);
+
+  // add interpolated lengths of fine nodes to coarse graph g
+  void aggregate_lengths(BasicGraph* g) const;
+
+  // append arc (i, j) with given reverse arc to arcs of node i
+  typename Arc::Index append_arc(typename Node::Index i, typename Node::Index j, Float w, Float b, typename Arc::Index r);
 
   // add contribution of fine arc to coarse graph
-  void update(Node::Index i, Node::Index j, Float w, Float b);
+  void update(typename Node::Index i, typename Node::Index j, Float w, Float b);
 
   // transfer contribution of fine arc a to coarse node p
-  void transfer(Graph* g, const std::vector<Float>& part, Node::Index p, Arc::Index a, Float f = 1) const;
+  template <class Sink>
+  void transfer(Sink* s, const std::vector<Float>& part, typename Node::Index p, typename Arc::Index a, Float f = 1) const;
+
+  // gather contributions of fine arcs to arcs of coarse node p
+  template <class Sink>
+  void gather(Sink* s, const std::vector<Float>& part, typename Node::Index p) const;
+
+  // list arcs (i, j) satisfying predicate(i, j, w)
+  template <class Predicate>
+  std::vector<typename Arc::Index> select(Predicate predicate) const
+  {
+    std::vector<typename Arc::Index> arcs;
+    for (typename Node::Index i = 1; i < pos.size(); i++)
+      for (typename Arc::Index a = node_begin(i); a < node_end(i); a++)
+        if (predicate(i, adj[a], arc_weight(a)))
+          arcs.push_back(a);
+    return arcs;
+  }
+
+  // remove marked arcs
+  I compact(const std::vector<bool>& mark);
 
   // swap the positions of nodes
-  void swap(uint k, uint l);
+  void swap(I k, I l);
 
   // random number generator
-  static uint random(uint seed = 0);
+  uint random(uint seed = 0);
 
-  uint level;            // level of coarsening
-  Node::Index last_node; // last node with outgoing arcs
+  Activity tally;                 // work done by order()
+  uint level;                     // level of coarsening
+  typename Node::Index last_node; // last node with outgoing arcs
+  uint state;                     // random number generator state
 };
 
+// Graphs with 16-, 32-, and 64-bit indices.  The 32-bit variants are the
+// default.
+typedef BasicGraph<uint16_t> Graph16;
+typedef BasicGraph<uint32_t> Graph32;
+typedef BasicGraph<uint64_t> Graph64;
+
+typedef BasicArc<uint32_t> Arc;
+typedef BasicEdge<uint32_t> Edge;
+typedef BasicNode<uint32_t> Node;
+typedef BasicGraph<uint32_t> Graph;
+
 }
 
 #endif
@@ -6,12 +6,14 @@
 
 namespace Gecko {
 
-class Graph;
+template <typename I> class BasicGraph;
 
 // Callbacks between iterations and phases.
-class Progress {
+template <typename I>
+class BasicProgress {
 public:
-  virtual ~Progress() {}
+  typedef BasicGraph<I> Graph;
+  virtual ~BasicProgress() {}
   virtual void beginorder(const Graph* /*graph*/, Float /*cost*/) const {}
   virtual void endorder(const Graph* /*graph*/, Float /*cost*/) const {}
   virtual void beginiter(const Graph* /*graph*/, uint /*iter*/, uint /*maxiter*/, uint /*window*/) const {}
@@ -21,6 +23,8 @@ public:
   virtual bool quit() const { return false; }
 };
 
+typedef BasicProgress<uint32_t> Progress;
+
 }
 
 #endif
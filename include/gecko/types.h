@@ -3,6 +3,7 @@
 
 #include <cfloat>
 #include <limits>
+#include <stdint.h>
 
 #define GECKO_FLOAT_EPSILON std::numeric_limits<Float>::epsilon()
 #define GECKO_FLOAT_MAX std::numeric_limits<Float>::max()
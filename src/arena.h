@@ -0,0 +1,196 @@
+#ifndef GECKO_ARENA_H
+#define GECKO_ARENA_H
+
+#include <cstddef>
+#include <vector>
+#include "gecko/graph.h"
+#include "heap.h"
+#include "subgraph.h"
+#if GECKO_WITH_OPENMP
+  #include <omp.h>
+#endif
+
+namespace Gecko {
+
+// Coarse arcs of a block of consecutive coarse nodes, gathered by a single
+// thread and later appended to the coarse graph in order.  Arcs (p, q) of
+// the current node p are located via a thread-private marker array.
+template <typename I>
+class Rows {
+public:
+  typedef typename BasicGraph<I>::Arc Arc;
+  typedef typename BasicGraph<I>::Node Node;
+
+  // begin new block using given marker array indexed by coarse node
+  void clear(std::vector<typename Arc::Index>* mark)
+  {
+    this->mark = mark;
+    target.clear();
+    weight.clear();
+    bond.clear();
+    end.clear();
+  }
+
+  // add contribution of fine arc to arc (p, q) of current node p
+  void update(typename Node::Index, typename Node::Index q, Float w, Float b)
+  {
+    typename Arc::Index& a = (*mark)[q];
+    if (a == Arc::null) {
+      target.push_back(q);
+      weight.push_back(0);
+      bond.push_back(0);
+      a = typename Arc::Index(target.size());
+    }
+    weight[a - 1] += w;
+    bond[a - 1] += b;
+  }
+
+  // end arcs of current node and reset their markers
+  void finish()
+  {
+    for (size_t k = begin(end.size()); k < target.size(); k++)
+      (*mark)[target[k]] = Arc::null;
+    end.push_back(target.size());
+  }
+
+  // first arc of k-th node in block
+  size_t begin(size_t k) const { return k ? end[k - 1] : 0; }
+
+  std::vector<typename Node::Index> target; // arc targets
+  std::vector<Float> weight;                // arc weights
+  std::vector<Float> bond;                  // arc bonds
+  std::vector<size_t> end;                  // one past last arc of each node
+private:
+  std::vector<typename Arc::Index>* mark;   // arc (p, q) indexed by q
+};
+
+// Nodes of a graph partitioned into independent sets, or colors, whose
+// nodes may be relaxed concurrently.
+template <typename I>
+class Coloring {
+public:
+  typedef typename BasicGraph<I>::Node Node;
+
+  void clear()
+  {
+    node.clear();
+    end.clear();
+  }
+  bool empty() const { return end.empty(); }
+
+  // number of colors and first node of color c
+  size_t colors() const { return end.size(); }
+  size_t begin(size_t c) const { return c ? end[c - 1] : 0; }
+
+  std::vector<typename Node::Index> node;   // nodes ordered by color
+  std::vector<size_t> end;                  // one past last node of each color
+};
+
+// Storage for the multilevel hierarchy built by Graph::order().  Coarse
+// graphs and scratch arrays are retained across V-cycles, such that once
+// their capacities have settled, V-cycles allocate no further memory for
+// them.  The aggregates and interpolation weights of each level may also
+// be reused in place of recoarsening.
+template <typename I>
+class Arena {
+public:
+  typedef BasicGraph<I> Graph;
+  typedef typename Graph::Arc Arc;
+  typedef typename Graph::Node Node;
+
+  // constructor of arena for fine graph with given number of levels,
+  // nodes, and arcs, to be ordered using given number of threads
+  Arena(uint levels, size_t nodes, size_t arcs, uint threads = 0) :
+    graph(levels, 0),
+    part(levels),
+    external(1),
+    cache(1),
+    slot(1),
+    valid(levels),
+    reuse(false),
+    activity(0),
+    policy(policy_virtual)
+  {
+    heap.reserve(nodes + 1);
+    child.reserve(nodes + 1);
+    if (levels)
+      part[levels - 1].reserve(arcs);
+#if GECKO_WITH_OPENMP
+    this->threads = threads ? int(threads) : omp_get_max_threads();
+    level = omp_get_level();
+    coloring.resize(levels + 1);
+    values.resize(this->threads);
+    external.resize(this->threads);
+    cache.resize(this->threads);
+    slot.resize(this->threads);
+#else
+    (void)threads;
+#endif
+#if GECKO_WITH_SUBSET_DP
+    subset.resize(cache.size());
+#endif
+#if GECKO_WITH_ACTIVE_SET
+    settled.resize(levels + 1);
+    pending.resize(levels + 1);
+#endif
+  }
+
+  // destructor releases all coarse graphs
+  ~Arena()
+  {
+    for (size_t k = 0; k < graph.size(); k++)
+      delete graph[k];
+  }
+
+  std::vector<Graph*> graph;                 // coarse graph at each level
+  std::vector<std::vector<Float> > part;     // fine arc interpolation weights
+  DynamicHeap<typename Node::Index, Float, std::less<Float>, typename Node::Index> heap; // node priorities
+#if GECKO_WITH_BUCKET_QUEUE
+  BucketQueue<typename Node::Index, Float> queue; // approximate node priorities
+#endif
+  std::vector<typename Node::Index> child;   // fine node of each coarse node
+  std::vector<typename Arc::Index> mark;     // coarse arc (p, q) indexed by q
+  std::vector<typename Arc::Index> rev;      // coarse arc (q, p) indexed by q
+  std::vector<typename Arc::Index> head;     // first queued coarse arc into node
+  std::vector<typename Arc::Index> next;     // next queued coarse arc
+  std::vector<typename Node::Index> from;    // source node of queued coarse arc
+  std::vector<WeightedValue> value;          // positions of node's neighbors
+  std::vector<std::vector<WeightedValue> > external; // per-thread subgraph external neighbors
+  std::vector<std::vector<Subnode> > cache;  // per-thread subgraph positions and costs
+  std::vector<std::vector<Subnode::Index> > slot; // per-thread subgraph slot + 1 of each node
+  std::vector<Float> bond;                   // fine bonds when last coarsened
+#if GECKO_WITH_SUBSET_DP
+  std::vector<std::vector<Subset> > subset;  // per-thread subgraph subset optima
+#endif
+#if GECKO_WITH_ACTIVE_SET
+  std::vector<std::vector<Float> > settled;  // positions at end of last V-cycle at each level
+  std::vector<std::vector<char> > pending;   // nodes near last window changes at each level
+  std::vector<char> dirty;                   // active nodes of current level
+  std::vector<Float> prior;                  // positions at start of current phase
+#endif
+#if GECKO_WITH_OPENMP
+  // index of calling thread within parallel regions of Graph::order()
+  int thread() const { return omp_get_level() > level ? omp_get_thread_num() : 0; }
+
+  int threads;                               // number of threads
+  int level;                                 // OpenMP nesting level of Graph::order()
+  std::vector<Float> importance;             // importance of undecided nodes
+  std::vector<char> selected;                // nodes selected in current round
+  std::vector<typename Node::Index> active;  // undecided nodes
+  std::vector<Rows<I> > rows;                // coarse arcs of blocks of nodes
+  std::vector<std::vector<typename Arc::Index> > marks; // per-thread markers
+  std::vector<Coloring<I> > coloring;        // independent sets at each level
+  std::vector<uint> color;                   // color of each node
+  std::vector<std::vector<WeightedValue> > values; // per-thread neighbor positions
+  std::vector<Float> frozen;                 // positions at start of optimization phase
+  std::vector<typename Node::Index> rank;    // ranks at start of optimization phase
+#endif
+  uint valid;                                // lowest level with valid aggregates
+  bool reuse;                                // reuse aggregates in this V-cycle?
+  Activity* activity;                        // work done by Graph::order()
+  uint policy;                               // policy of ordering functional
+};
+
+}
+
+#endif
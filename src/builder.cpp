@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <limits>
+#include "gecko/builder.h"
+
+using namespace std;
+using namespace Gecko;
+
+// Reserve space for given number of edges.
+template <typename I>
+void
+BasicGraphBuilder<I>::reserve(size_t edges)
+{
+  head.reserve(edges);
+  tail.reserve(edges);
+  weight.reserve(edges);
+}
+
+// Insert undirected edge {i, j}.
+template <typename I>
+bool
+BasicGraphBuilder<I>::insert_edge(typename Node::Index i, typename Node::Index j, Float w)
+{
+  if (!i || !j || i == j)
+    return false;
+  count = std::max(count, std::max(i, j));
+  head.push_back(i);
+  tail.push_back(j);
+  weight.push_back(w);
+  return true;
+}
+
+// Assemble graph in compressed sparse row format.  The arcs (i, j) and
+// (j, i) of each edge are sorted on (i, j) using a two-pass least
+// significant digit radix sort with one digit per node index, after which
+// duplicate arcs are adjacent and are merged.
+template <typename I>
+bool
+BasicGraphBuilder<I>::build(Graph& graph)
+{
+  size_t edges = head.size();
+
+  // Ensure all nodes and arcs can be indexed.
+  if (count >= std::numeric_limits<I>::max() || edges >= std::numeric_limits<I>::max() / 2)
+    return false;
+
+  // Count arcs per node and compute one past the last arc of each node.
+  // Since each edge contributes an arc in both directions, in- and
+  // out-degrees agree.
+  vector<typename Arc::Index> offset(count + 1, 0);
+  offset[0] = 1;
+  for (size_t e = 0; e < edges; e++) {
+    offset[head[e]]++;
+    offset[tail[e]]++;
+  }
+  for (typename Node::Index i = 1; i <= count; i++)
+    offset[i] += offset[i - 1];
+  typename Arc::Index arcs = offset[count];
+
+  // Sort arcs on target node.
+  vector<typename Node::Index> from(arcs);
+  vector<Float> w(arcs);
+  {
+    vector<typename Arc::Index> next(offset.begin(), offset.end() - 1);
+    for (size_t e = 0; e < edges; e++) {
+      typename Node::Index i = head[e];
+      typename Node::Index j = tail[e];
+      typename Arc::Index a = next[j - 1]++;
+      from[a] = i;
+      w[a] = weight[e];
+      typename Arc::Index b = next[i - 1]++;
+      from[b] = j;
+      w[b] = weight[e];
+    }
+  }
+  vector<typename Node::Index>().swap(head);
+  vector<typename Node::Index>().swap(tail);
+  vector<Float>().swap(weight);
+
+  // Stably sort arcs on source node, which leaves each node's arcs in
+  // order of increasing target node.
+  vector<typename Node::Index> target(arcs);
+  vector<Float> value(arcs);
+  {
+    vector<typename Arc::Index> next(offset.begin(), offset.end() - 1);
+    typename Node::Index j = 1;
+    for (typename Arc::Index a = 1; a < arcs; a++) {
+      while (offset[j] <= a)
+        j++;
+      typename Arc::Index b = next[from[a] - 1]++;
+      target[b] = j;
+      value[b] = w[a];
+    }
+  }
+  vector<typename Node::Index>().swap(from);
+  vector<Float>().swap(w);
+
+  // Merge duplicate arcs, which are now adjacent.
+  typename Arc::Index a = 1;
+  typename Arc::Index b = 1;
+  for (typename Node::Index i = 1; i <= count; i++) {
+    typename Arc::Index begin = b;
+    for (typename Arc::Index end = offset[i]; a < end; a++)
+      if (b > begin && target[b - 1] == target[a])
+        value[b - 1] = accumulate ? value[b - 1] + value[a] : std::max(value[b - 1], value[a]);
+      else {
+        target[b] = target[a];
+        value[b] = value[a];
+        b++;
+      }
+    offset[i] = b;
+  }
+  target.resize(b);
+  value.resize(b);
+  target[0] = Node::null;
+  value[0] = 0;
+
+  count = 0;
+  return graph.adopt(offset, target, value);
+}
+
+// Explicit instantiations.
+namespace Gecko {
+template class BasicGraphBuilder<uint16_t>;
+template class BasicGraphBuilder<uint32_t>;
+template class BasicGraphBuilder<uint64_t>;
+}
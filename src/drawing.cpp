@@ -13,38 +13,44 @@ using namespace std;
 namespace Gecko {
 
 // node record for sorting
+template <typename I>
 class NodeRef {
 public:
-  NodeRef(Float x, Node::Index i) : pos(x), index(i) {}
+  NodeRef(Float x, I i) : pos(x), index(i) {}
   bool operator<(const NodeRef& node) const { return pos < node.pos; }
   Float pos;
-  Node::Index index;
+  I index;
 };
 
 // arc record for sorting
+template <typename I>
 class ArcRef {
 public:
-  ArcRef(Float l, Arc::Index a) : length(l), index(a) {}
+  ArcRef(Float l, I a) : length(l), index(a) {}
   bool operator<(const ArcRef& arc) const { return length < arc.length; }
   Float length;
-  Arc::Index index;
+  I index;
 };
 
 // draw graph
+template <typename I>
 void
-Drawing::draw(const Graph* g)
+Drawing::draw(const BasicGraph<I>* g)
 {
+  typedef typename BasicGraph<I>::Arc Arc;
+  typedef typename BasicGraph<I>::Node Node;
+
   device->begin();
 
   // sort nodes by increasing position, arcs by increasing length
-  vector<NodeRef> node;
-  vector<ArcRef> arc;
-  for (Node::Index i = 1; i <= g->nodes(); i++) {
-    node.push_back(NodeRef(g->node[i].pos, i));
-    for (Arc::Index a = g->node_begin(i); a < g->node_end(i); a++) {
-      Node::Index j = g->arc_target(a);
-      if (g->node[i].pos < g->node[j].pos)
-        arc.push_back(ArcRef(g->length(i, j), a));
+  vector<NodeRef<I> > node;
+  vector<ArcRef<I> > arc;
+  for (typename Node::Index i = 1; i <= g->nodes(); i++) {
+    node.push_back(NodeRef<I>(g->pos[i], i));
+    for (typename Arc::Index a = g->node_begin(i); a < g->node_end(i); a++) {
+      typename Node::Index j = g->arc_target(a);
+      if (g->pos[i] < g->pos[j])
+        arc.push_back(ArcRef<I>(g->length(i, j), a));
     }
   }
   sort(node.begin(), node.end());
@@ -52,21 +58,21 @@ Drawing::draw(const Graph* g)
 
   // assign arc attachment points
   vector<unsigned char> anchor(2 * g->edges() + 1, 0);
-  for (vector<ArcRef>::const_iterator p = arc.begin(); p != arc.end(); p++)
+  for (typename vector<ArcRef<I> >::const_iterator p = arc.begin(); p != arc.end(); p++)
     if (p->length >= 0.5) {
-      Arc::Index a = p->index;
-      Arc::Index b = g->reverse_arc(a);
-      Node::Index i = g->arc_source(a);
-      Node::Index j = g->arc_target(a);
+      typename Arc::Index a = p->index;
+      typename Arc::Index b = g->reverse_arc(a);
+      typename Node::Index i = g->arc_source(a);
+      typename Node::Index j = g->arc_target(a);
       uint source[7] = {};
       uint target[7] = {};
-      for (Arc::Index c = g->node_begin(i); c < g->node_end(i); c++)
+      for (typename Arc::Index c = g->node_begin(i); c < g->node_end(i); c++)
         source[anchor[c]]++;
-      for (Arc::Index c = g->node_begin(j); c < g->node_end(j); c++)
+      for (typename Arc::Index c = g->node_begin(j); c < g->node_end(j); c++)
         target[anchor[c]]++;
       if (!source[SOURCE_MID] && !target[TARGET_MID]) {
-        vector<NodeRef>::const_iterator q = upper_bound(node.begin(), node.end(), NodeRef(g->node[i].pos, i));
-        if (q->pos >= g->node[j].pos) {
+        typename vector<NodeRef<I> >::const_iterator q = upper_bound(node.begin(), node.end(), NodeRef<I>(g->pos[i], i));
+        if (q->pos >= g->pos[j]) {
           // no nodes are between i and j
           anchor[a] = SOURCE_MID;
           anchor[b] = TARGET_MID;
@@ -84,31 +90,36 @@ Drawing::draw(const Graph* g)
     }
 
   // draw arcs
-  for (vector<ArcRef>::const_reverse_iterator p = arc.rbegin(); p != arc.rend(); p++) {
-    Arc::Index a = p->index;
-    Node::Index i = g->arc_source(a);
-    Node::Index j = g->arc_target(a);
+  for (typename vector<ArcRef<I> >::const_reverse_iterator p = arc.rbegin(); p != arc.rend(); p++) {
+    typename Arc::Index a = p->index;
+    typename Node::Index i = g->arc_source(a);
+    typename Node::Index j = g->arc_target(a);
     switch (anchor[a]) {
       case SOURCE_BOT:
       case TARGET_BOT:
-        device->edge(g->node[i].pos, g->node[j].pos, g->weight[a], false);
+        device->edge(g->pos[i], g->pos[j], g->arc_weight(a), false);
         break;
       case SOURCE_TOP:
       case TARGET_TOP:
-        device->edge(g->node[i].pos, g->node[j].pos, g->weight[a], true);
+        device->edge(g->pos[i], g->pos[j], g->arc_weight(a), true);
         break;
       case SOURCE_MID:
       case TARGET_MID:
-        device->edge(g->node[i].pos, g->node[j].pos, g->weight[a]);
+        device->edge(g->pos[i], g->pos[j], g->arc_weight(a));
         break;
     }
   }
 
   // draw nodes
-  for (Node::Index i = 1; i <= g->nodes(); i++)
-    device->node(g->node[i].pos, Float(0.5) * g->node[i].hlen, g->persistent(i) ? Float(0.25) : Float(0.75));
+  for (typename Node::Index i = 1; i <= g->nodes(); i++)
+    device->node(g->pos[i], Float(0.5) * g->hlen[i], g->persistent(i) ? Float(0.25) : Float(0.75));
 
   device->end();
 }
 
+// explicit instantiations
+template void Drawing::draw(const BasicGraph<uint16_t>* g);
+template void Drawing::draw(const BasicGraph<uint32_t>* g);
+template void Drawing::draw(const BasicGraph<uint64_t>* g);
+
 }
@@ -5,204 +5,616 @@
 #include <sstream>
 #include <stdexcept>
 #include "gecko/graph.h"
+#include "arena.h"
 #include "subgraph.h"
 #include "heap.h"
+#if GECKO_WITH_OPENMP
+  #include <omp.h>
+#endif
 
 using namespace std;
 using namespace Gecko;
 
+#if GECKO_WITH_OPENMP
+// Does node i precede node j in pseudorandom order?
+template <typename I>
+static inline bool
+precedes(I i, I j)
+{
+  uint32_t hi = uint32_t(i) * 0x9e3779b1u;
+  uint32_t hj = uint32_t(j) * 0x9e3779b1u;
+  return hi != hj ? hi > hj : i > j;
+}
+
+// Does node i precede node j in order of importance w, with ties broken
+// pseudorandomly?
+template <typename I>
+static inline bool
+precedes(const vector<Float>& w, I i, I j)
+{
+  return w[i] != w[j] ? w[i] > w[j] : precedes(i, j);
+}
+#endif
+
 // Constructor.
+template <typename I>
 void
-Graph::init(uint nodes)
+BasicGraph<I>::init(I nodes)
 {
-  node.push_back(Node(-1, 0, 1, Node::null));
+  pos.push_back(-1);
+  hlen.push_back(0);
+  offset.push_back(1);
+  parent.push_back(Node::null);
   adj.push_back(Node::null);
+  source.push_back(Node::null);
   weight.push_back(0);
   bond.push_back(0);
   while (nodes--)
     insert_node();
 }
 
+// Clear graph for reuse as coarse graph at given level.  Vectors are
+// cleared rather than released so that their storage may be reused.
+template <typename I>
+void
+BasicGraph<I>::reset(uint level, bool shared)
+{
+  this->level = level;
+  last_node = Node::null;
+  perm.clear();
+  pos.clear();
+  hlen.clear();
+  offset.clear();
+  parent.clear();
+  adj.clear();
+  source.clear();
+  twin.clear();
+  edge.clear();
+  weight.clear();
+  bond.clear();
+  init(0);
+  // Keep reverse arcs current as arcs are inserted.
+  twin.push_back(Arc::null);
+  if (shared) {
+    // Arc sources are given by the reverse arcs.
+    source.clear();
+    edge.push_back(Edge::null);
+  }
+}
+
+// Reserve storage for given number of nodes and arcs.
+template <typename I>
+void
+BasicGraph<I>::reserve(size_t nodes, size_t arcs)
+{
+  perm.reserve(nodes);
+  pos.reserve(nodes + 1);
+  hlen.reserve(nodes + 1);
+  offset.reserve(nodes + 1);
+  parent.reserve(nodes + 1);
+  adj.reserve(arcs + 1);
+  twin.reserve(arcs + 1);
+  if (shared_weights()) {
+    edge.reserve(arcs + 1);
+    weight.reserve(arcs / 2 + 1);
+    bond.reserve(arcs / 2 + 1);
+  }
+  else {
+    source.reserve(arcs + 1);
+    weight.reserve(arcs + 1);
+    bond.reserve(arcs + 1);
+  }
+}
+
+// Constructor of graph from zero-based compressed sparse row arrays.
+template <typename I>
+BasicGraph<I>::BasicGraph(I nodes, const typename Arc::Index* offset, const typename Node::Index* target, const Float* weight) : arena(0), thread_count(0), level(0), last_node(Node::null), state(1)
+{
+  // Reject graphs whose one-based node or arc indices would overflow.
+  if (!indexable(size_t(nodes) + 1) || offset[nodes] < offset[0] || !indexable(size_t(offset[nodes] - offset[0]) + 1))
+    throw std::invalid_argument("compressed sparse row graph too large to index");
+
+  // Convert to one-based indices with null entries at index zero.
+  typename Arc::Index arcs = offset[nodes] - offset[0];
+  vector<typename Arc::Index> o(nodes + 1);
+  for (typename Node::Index i = 0; i <= nodes; i++)
+    o[i] = offset[i] - offset[0] + 1;
+  vector<typename Node::Index> t(arcs + 1);
+  t[0] = Node::null;
+  for (typename Arc::Index a = 0; a < arcs; a++)
+    t[a + 1] = target[offset[0] + a] + 1;
+  vector<Float> w;
+  if (weight) {
+    w.resize(arcs + 1);
+    w[0] = 0;
+    std::copy(weight + offset[0], weight + offset[nodes], w.begin() + 1);
+  }
+  if (!adopt(o, t, w))
+    throw std::invalid_argument("invalid compressed sparse row graph");
+}
+
+// Adopt graph in compressed sparse row format.  Arcs of node i are
+// {offset[i-1], ..., offset[i]-1} with offset[0] = 1, and target[0] and
+// weight[0] are unused.  An empty weight array implies unit weights.  On
+// success, the arrays are taken over by the graph and left empty.
+template <typename I>
+bool
+BasicGraph<I>::adopt(vector<typename Arc::Index>& offset, vector<typename Node::Index>& target, vector<Float>& weight)
+{
+  // Validate arrays before modifying the graph.
+  if (offset.empty() || !indexable(offset.size()) || offset[0] != 1 || offset.back() != target.size())
+    return false;
+  if (!weight.empty() && weight.size() != target.size())
+    return false;
+  I nodes = I(offset.size() - 1);
+  for (typename Node::Index i = 1; i <= nodes; i++) {
+    if (offset[i] < offset[i - 1])
+      return false;
+    for (typename Arc::Index a = offset[i - 1]; a < offset[i]; a++) {
+      typename Node::Index j = target[a];
+      if (!j || j == i || j > nodes)
+        return false;
+    }
+  }
+
+  // Initialize nodes and take over arc offsets.
+  pos.assign(nodes + 1, Float(-1));
+  hlen.assign(nodes + 1, Float(0.5));
+  hlen[0] = 0;
+  parent.assign(nodes + 1, Node::null);
+  this->offset.swap(offset);
+  perm.resize(nodes);
+  for (typename Node::Index i = 1; i <= nodes; i++)
+    perm[i - 1] = i;
+  last_node = nodes;
+
+  // Take over arcs.
+  adj.swap(target);
+  adj[0] = Node::null;
+  source.resize(adj.size());
+  source[0] = Node::null;
+  for (typename Node::Index i = 1; i <= nodes; i++)
+    std::fill(source.begin() + node_begin(i), source.begin() + node_end(i), i);
+  if (weight.empty()) {
+    this->weight.clear();
+    bond.assign(adj.size(), Float(1));
+  }
+  else {
+    this->weight.swap(weight);
+    this->weight[0] = 0;
+    bond = this->weight;
+  }
+  bond[0] = 0;
+  twin.clear();
+  edge.clear();
+
+  // Release caller's arrays.
+  vector<typename Arc::Index>().swap(offset);
+  vector<typename Node::Index>().swap(target);
+  vector<Float>().swap(weight);
+
+  return true;
+}
+
 // Insert node.
-Node::Index
-Graph::insert_node(Float length)
+template <typename I>
+typename BasicGraph<I>::Node::Index
+BasicGraph<I>::insert_node(Float length)
 {
-  Node::Index p = Node::Index(node.size());
+  if (!indexable(pos.size() + 1))
+    return Node::null;
+  typename Node::Index p = typename Node::Index(pos.size());
   perm.push_back(p);
-  node.push_back(Node(-1, length));
+  pos.push_back(-1);
+  hlen.push_back(Float(0.5) * length);
+  offset.push_back(Arc::null);
+  parent.push_back(Node::null);
   return p;
 }
 
 // Return nodes adjacent to i.
-std::vector<Node::Index>
-Graph::node_neighbors(Node::Index i) const
+template <typename I>
+std::vector<typename BasicGraph<I>::Node::Index>
+BasicGraph<I>::node_neighbors(typename Node::Index i) const
 {
-  std::vector<Node::Index> neighbor;
-  for (Arc::Index a = node_begin(i); a < node_end(i); a++)
+  std::vector<typename Node::Index> neighbor;
+  for (typename Arc::Index a = node_begin(i); a < node_end(i); a++)
     neighbor.push_back(adj[a]);
   return neighbor;
 }
 
 // Insert directed edge (i, j).
-Arc::Index
-Graph::insert_arc(Node::Index i, Node::Index j, Float w, Float b)
+template <typename I>
+typename BasicGraph<I>::Arc::Index
+BasicGraph<I>::insert_arc(typename Node::Index i, typename Node::Index j, Float w, Float b)
 {
-  if (!i || !j || i == j || !(last_node <= i && i <= nodes()))
+  if (!i || !j || i == j || !(last_node <= i && i <= nodes()) || !indexable(adj.size() + 1))
     return Arc::null;
+  // Pair arc with its reverse arc if reverse arcs are current.
+  typename Arc::Index r = twin.size() == adj.size() && j < i ? arc_index(j, i) : typename Arc::Index(Arc::null);
+  return append_arc(i, j, w, b, r);
+}
+
+// Append arc (i, j) with reverse arc r, if known, to arcs of node i.
+template <typename I>
+typename BasicGraph<I>::Arc::Index
+BasicGraph<I>::append_arc(typename Node::Index i, typename Node::Index j, Float w, Float b, typename Arc::Index r)
+{
   last_node = i;
-  for (Node::Index k = i - 1; node[k].arc == Arc::null; k--)
-    node[k].arc = Arc::Index(adj.size());
+  for (typename Node::Index k = i - 1; offset[k] == Arc::null; k--)
+    offset[k] = typename Arc::Index(adj.size());
+  if (unit_weights() && w != 1) {
+    // Store weights explicitly.
+    weight.assign(bond.size(), Float(1));
+    weight[0] = 0;
+  }
+  typename Arc::Index a = typename Arc::Index(adj.size());
+  if (twin.size() == adj.size()) {
+    if (r != Arc::null)
+      twin[r] = a;
+    twin.push_back(r);
+  }
+  else
+    twin.clear();
   adj.push_back(j);
-  weight.push_back(w);
-  bond.push_back(b);
-  node[i].arc = Arc::Index(adj.size());
-  return Arc::Index(adj.size() - 1);
+  if (shared_weights()) {
+    // Attach arc to the edge of its reverse arc if present; otherwise
+    // create a new edge.
+    if (r != Arc::null)
+      edge.push_back(edge[r]);
+    else {
+      edge.push_back(typename Edge::Index(bond.size()));
+      if (!unit_weights())
+        weight.push_back(w);
+      bond.push_back(b);
+    }
+  }
+  else {
+    source.push_back(i);
+    if (!unit_weights())
+      weight.push_back(w);
+    bond.push_back(b);
+  }
+  offset[i] = typename Arc::Index(adj.size());
+  return a;
 }
 
 // Remove arc a.
+template <typename I>
 bool
-Graph::remove_arc(Arc::Index a)
+BasicGraph<I>::remove_arc(typename Arc::Index a)
 {
-  if (a == Arc::null)
+  if (a == Arc::null || a >= adj.size())
     return false;
-  Node::Index i = arc_source(a);
-  adj.erase(adj.begin() + a);
-  weight.erase(weight.begin() + a);
-  bond.erase(bond.begin() + a);
-  for (Node::Index k = i; k < node.size(); k++)
-    node[k].arc--;
-  return true;
+  vector<bool> mark(adj.size(), false);
+  mark[a] = true;
+  return compact(mark) != 0;
 }
 
 // Remove directed edge (i, j).
+template <typename I>
 bool
-Graph::remove_arc(Node::Index i, Node::Index j)
+BasicGraph<I>::remove_arc(typename Node::Index i, typename Node::Index j)
 {
   return remove_arc(arc_index(i, j));
 }
 
-// Remove edge {i, j}.
+// Remove edge {i, j}.  Both arcs are removed in a single pass, as arcs of
+// shared edges cannot be removed one at a time.
+template <typename I>
 bool
-Graph::remove_edge(Node::Index i, Node::Index j)
+BasicGraph<I>::remove_edge(typename Node::Index i, typename Node::Index j)
 {
-  bool success = remove_arc(i, j);
-  if (success)
-    success = remove_arc(j, i);
-  return success;
+  typename Arc::Index a = arc_index(i, j);
+  if (a == Arc::null)
+    return false;
+  typename Arc::Index b = arc_index(j, i);
+  vector<bool> mark(adj.size(), false);
+  mark[a] = true;
+  mark[b] = b != Arc::null;
+  return compact(mark) == 2;
+}
+
+// Remove arcs in a single pass.
+template <typename I>
+I
+BasicGraph<I>::remove_arcs(const vector<typename Arc::Index>& arcs)
+{
+  vector<bool> mark(adj.size(), false);
+  for (typename Arc::ConstPtr ap = arcs.begin(); ap != arcs.end(); ap++)
+    if (*ap != Arc::null && *ap < adj.size())
+      mark[*ap] = true;
+  return compact(mark);
+}
+
+// Remove arcs and their reverse arcs in a single pass.
+template <typename I>
+I
+BasicGraph<I>::remove_edges(const vector<typename Arc::Index>& arcs)
+{
+  if (twin.size() != adj.size())
+    twin_arcs();
+  vector<bool> mark(adj.size(), false);
+  for (typename Arc::ConstPtr ap = arcs.begin(); ap != arcs.end(); ap++)
+    if (*ap != Arc::null && *ap < adj.size()) {
+      mark[*ap] = true;
+      mark[twin[*ap]] = true;
+    }
+  mark[Arc::null] = false;
+  return compact(mark);
+}
+
+// Remove marked arcs by compacting the arc arrays and node offsets.  Fails
+// if weights are shared and an arc is marked without its reverse arc,
+// which gives the arc's source.
+template <typename I>
+I
+BasicGraph<I>::compact(const vector<bool>& mark)
+{
+  if (shared_weights())
+    for (typename Arc::Index a = 1; a < adj.size(); a++)
+      if (mark[a] && !mark[twin[a]])
+        return 0;
+
+  // Compact arc arrays and record new arc indices for the reverse arcs.
+  bool paired = twin.size() == adj.size();
+  vector<typename Arc::Index> index(paired ? adj.size() : 0, Arc::null);
+  typename Arc::Index a = 1;
+  typename Arc::Index b = 1;
+  for (typename Node::Index i = 1; i < pos.size() && offset[i] != Arc::null; i++) {
+    for (; a < node_end(i); a++)
+      if (!mark[a]) {
+        adj[b] = adj[a];
+        if (paired) {
+          index[a] = b;
+          twin[b] = twin[a];
+        }
+        if (shared_weights())
+          edge[b] = edge[a];
+        else {
+          source[b] = source[a];
+          if (!unit_weights())
+            weight[b] = weight[a];
+          bond[b] = bond[a];
+        }
+        b++;
+      }
+    offset[i] = b;
+  }
+  I count = I(adj.size() - b);
+  adj.resize(b);
+  if (paired) {
+    twin.resize(b);
+    for (typename Arc::Index c = 1; c < b; c++)
+      twin[c] = index[twin[c]];
+  }
+
+  if (shared_weights()) {
+    // Renumber remaining edges and compact their weights and bonds.
+    edge.resize(b);
+    vector<typename Edge::Index> id(bond.size(), Edge::null);
+    vector<Float> w(unit_weights() ? 0 : 1, Float(0));
+    vector<Float> m(1, Float(0));
+    for (typename Arc::Index c = 1; c < b; c++) {
+      typename Edge::Index e = edge[c];
+      if (id[e] == Edge::null) {
+        id[e] = typename Edge::Index(m.size());
+        if (!unit_weights())
+          w.push_back(weight[e]);
+        m.push_back(bond[e]);
+      }
+      edge[c] = id[e];
+    }
+    weight.swap(w);
+    bond.swap(m);
+  }
+  else {
+    source.resize(b);
+    if (!unit_weights())
+      weight.resize(b);
+    bond.resize(b);
+  }
+
+  return count;
 }
 
 // Index of arc (i, j) or null if not a valid arc.
-Arc::Index
-Graph::arc_index(Node::Index i, Node::Index j) const
+template <typename I>
+typename BasicGraph<I>::Arc::Index
+BasicGraph<I>::arc_index(typename Node::Index i, typename Node::Index j) const
 {
-  for (Arc::Index a = node_begin(i); a < node_end(i); a++)
+  for (typename Arc::Index a = node_begin(i); a < node_end(i); a++)
     if (adj[a] == j)
       return a;
   return Arc::null;
 }
 
-// Return source node i in arc a = (i, j).
-Node::Index
-Graph::arc_source(Arc::Index a) const
+// Return reverse arc (j, i) of arc a = (i, j).
+template <typename I>
+typename BasicGraph<I>::Arc::Index
+BasicGraph<I>::reverse_arc(typename Arc::Index a) const
 {
-  Node::Index j = adj[a];
-  for (Arc::Index b = node_begin(j); b < node_end(j); b++) {
-    Node::Index i = adj[b];
-    if (node_begin(i) <= a && a < node_end(i))
-      return i;
-  }
-  // should never get here
-  throw std::runtime_error("internal data structure corrupted");
+  return twin.size() == adj.size() ? twin[a] : arc_index(arc_target(a), arc_source(a));
 }
 
-// Return reverse arc (j, i) of arc a = (i, j).
-Arc::Index
-Graph::reverse_arc(Arc::Index a) const
+// Pair each arc with its reverse arc in time linear in the number of arcs.
+template <typename I>
+void
+BasicGraph<I>::twin_arcs()
 {
-  Node::Index j = adj[a];
-  for (Arc::Index b = node_begin(j); b < node_end(j); b++) {
-    Node::Index i = adj[b];
-    if (node_begin(i) <= a && a < node_end(i))
-      return b;
+  // Bucket arcs (i, j) on target j.
+  vector<typename Arc::Index> first(pos.size(), 0);
+  for (typename Arc::Index a = 1; a < adj.size(); a++)
+    first[adj[a]]++;
+  for (typename Node::Index j = 0, n = 1; j < pos.size(); j++) {
+    typename Arc::Index m = first[j];
+    first[j] = n;
+    n += m;
+  }
+  vector<typename Arc::Index> in(adj.size(), Arc::null);
+  for (typename Arc::Index a = 1; a < adj.size(); a++)
+    in[first[adj[a]]++] = a;
+
+  // For each node j, look up the reverse (j, i) of each incoming arc (i, j).
+  vector<typename Arc::Index> mark(pos.size(), Arc::null);
+  twin.assign(adj.size(), Arc::null);
+  for (typename Node::Index j = 1, n = first[0]; j < pos.size(); n = first[j++]) {
+    for (typename Arc::Index b = node_begin(j); b < node_end(j); b++)
+      mark[adj[b]] = b;
+    for (typename Arc::Index c = n; c < first[j]; c++) {
+      typename Arc::Index a = in[c];
+      twin[a] = mark[source[a]];
+    }
+    for (typename Arc::Index b = node_begin(j); b < node_end(j); b++)
+      mark[adj[b]] = Arc::null;
   }
-  return Arc::null;
 }
 
 // Return first directed arc if one exists or null otherwise.
-Arc::Index
-Graph::directed() const
+template <typename I>
+typename BasicGraph<I>::Arc::Index
+BasicGraph<I>::directed() const
 {
-  for (Node::Index i = 1; i < node.size(); i++)
-    for (Arc::Index a = node_begin(i); a < node_end(i); a++) {
-      Node::Index j = adj[a];
+  for (typename Node::Index i = 1; i < pos.size(); i++)
+    for (typename Arc::Index a = node_begin(i); a < node_end(i); a++) {
+      typename Node::Index j = adj[a];
       if (!arc_index(j, i))
         return a;
     }
   return Arc::null;
 }
 
-// Add contribution of fine arc to coarse graph.
+// Store weights of undirected edges once.  Fails if the graph is directed
+// or if the two arcs of an edge differ in weight.
+template <typename I>
+bool
+BasicGraph<I>::share_weights()
+{
+  if (shared_weights())
+    return true;
+  if (twin.size() != adj.size())
+    twin_arcs();
+  for (typename Arc::Index a = 1; a < adj.size(); a++) {
+    typename Arc::Index b = twin[a];
+    if (b == Arc::null || twin[b] != a || arc_weight(a) != arc_weight(b))
+      return false;
+  }
+
+  // Number edges in order of their first arc.
+  vector<typename Edge::Index> id(adj.size(), Edge::null);
+  vector<Float> w(unit_weights() ? 0 : 1, Float(0));
+  vector<Float> m(1, Float(0));
+  w.reserve(w.size() + edges());
+  m.reserve(m.size() + edges());
+  for (typename Arc::Index a = 1; a < adj.size(); a++)
+    if (a < twin[a]) {
+      id[a] = id[twin[a]] = typename Edge::Index(m.size());
+      if (!unit_weights())
+        w.push_back(weight[a]);
+      m.push_back((bond[a] + bond[twin[a]]) / 2);
+    }
+  edge.swap(id);
+  weight.swap(w);
+  bond.swap(m);
+
+  // Arc sources are now given by the reverse arcs.
+  vector<typename Node::Index>().swap(source);
+
+  return true;
+}
+
+// Treat all arcs as having unit weight and release weight storage.  Fails
+// if not all weights are equal.
+template <typename I>
+bool
+BasicGraph<I>::discard_weights()
+{
+  for (typename Arc::Index a = 2; a < adj.size(); a++)
+    if (arc_weight(a) != arc_weight(1))
+      return false;
+  vector<Float>().swap(weight);
+  return true;
+}
+
+// Add contribution of fine arc to arc (i, j) of coarse graph, where i is
+// the node whose arcs are being accumulated.  The arena's marker arrays
+// give the arc (i, j) and its reverse arc, if present, in constant time.
+template <typename I>
 void
-Graph::update(Node::Index i, Node::Index j, Float w, Float b)
+BasicGraph<I>::update(typename Node::Index i, typename Node::Index j, Float w, Float b)
 {
-  Arc::Index a = arc_index(i, j);
+  typename Arc::Index& a = arena->mark[j];
   if (a == Arc::null)
-    insert_arc(i, j, w, b);
-  else {
-    weight[a] += w;
-    bond[a] += b;
-  }
+    a = append_arc(i, j, 0, 0, arena->rev[j]);
+  weight[arc_edge(a)] += w;
+  bond[arc_edge(a)] += b;
 }
 
 // Transfer contribution of fine arc a to coarse node p.
+template <typename I>
+template <class Sink>
 void
-Graph::transfer(Graph* g, const vector<Float>& part, Node::Index p, Arc::Index a, Float f) const
+BasicGraph<I>::transfer(Sink* s, const vector<Float>& part, typename Node::Index p, typename Arc::Index a, Float f) const
 {
-  Float w = f * weight[a];
-  Float m = f * bond[a];
-  Node::Index j = arc_target(a);
-  Node::Index q = node[j].parent;
+  Float w = f * arc_weight(a);
+  Float m = f * bond[arc_edge(a)];
+  typename Node::Index j = arc_target(a);
+  typename Node::Index q = parent[j];
   if (q == Node::null) {
-    for (Arc::Index b = node_begin(j); b < node_end(j); b++)
+    for (typename Arc::Index b = node_begin(j); b < node_end(j); b++)
       if (part[b] > 0) {
-        q = node[adj[b]].parent;
+        q = parent[adj[b]];
         if (q != p)
-          g->update(p, q, w * part[b], m * part[b]);
+          s->update(p, q, w * part[b], m * part[b]);
       }
   }
   else
-    g->update(p, q, w, m);
+    s->update(p, q, w, m);
 }
 
-// Compute cost of a subset of arcs incident on node placed at pos.
-WeightedSum
-Graph::cost(const vector<Arc::Index>& subset, Float pos) const
+// Gather contributions of fine arcs to arcs of coarse node p, i.e., of
+// the arcs of its fine node and of the partial nodes assigned to it.
+template <typename I>
+template <class Sink>
+void
+BasicGraph<I>::gather(Sink* s, const vector<Float>& part, typename Node::Index p) const
 {
-  WeightedSum c;
-  for (Arc::ConstPtr ap = subset.begin(); ap != subset.end(); ap++) {
-    Arc::Index a = *ap;
-    Node::Index j = arc_target(a);
-    Float l = fabs(node[j].pos - pos);
-    Float w = weight[a];
-    functional->accumulate(c, WeightedValue(l, w));
+  typename Node::Index i = arena->child[p];
+  for (typename Arc::Index a = node_begin(i); a < node_end(i); a++) {
+    transfer(s, part, p, a);
+    typename Node::Index j = adj[a];
+    if (!persistent(j)) {
+      typename Arc::Index b = twin[a];
+      if (part[b] > 0)
+        for (typename Arc::Index c = node_begin(j); c < node_end(j); c++) {
+          typename Node::Index k = adj[c];
+          if (k != i)
+            transfer(s, part, p, c, part[b]);
+        }
+    }
   }
-  return c;
 }
 
 // Compute cost of graph layout.
+template <typename I>
 Float
-Graph::cost() const
+BasicGraph<I>::cost() const
 {
   if (edges()) {
     WeightedSum c;
-    Node::Index i = 1;
-    for (Arc::Index a = 1; a < adj.size(); a++) {
+    typename Node::Index i = 1;
+    for (typename Arc::Index a = 1; a < adj.size(); a++) {
       while (node_end(i) <= a)
         i++;
-      Node::Index j = arc_target(a);
+      // Visit each shared edge once.
+      if (shared_weights() && twin[a] < a)
+        continue;
+      typename Node::Index j = arc_target(a);
       Float l = length(i, j);
-      Float w = weight[a];
-      functional->accumulate(c, WeightedValue(l, w));
+      if (unit_weights())
+        functional->accumulate(c, l);
+      else
+        functional->accumulate(c, WeightedValue(l, weight[arc_edge(a)]));
     }
     return functional->mean(c);
   }
@@ -211,82 +623,219 @@ Graph::cost() const
 }
 
 // Swap the two nodes in positions k and l, k <= l.
+template <typename I>
 void
-Graph::swap(uint k, uint l)
+BasicGraph<I>::swap(I k, I l)
 {
-  Node::Index i = perm[k];
+  typename Node::Index i = perm[k];
   perm[k] = perm[l];
   perm[l] = i;
-  Float p = node[i].pos - node[i].hlen;
+  Float p = pos[i] - hlen[i];
   do {
     i = perm[k];
-    p += node[i].hlen;
-    node[i].pos = p;
-    p += node[i].hlen;
+    p += hlen[i];
+    pos[i] = p;
+    p += hlen[i];
   } while (k++ != l);
 }
 
 // Optimize continuous position of a single node.
+template <typename I>
 Float
-Graph::optimal(Node::Index i) const
+BasicGraph<I>::optimal(typename Node::Index i) const
 {
-  vector<WeightedValue> v;
-  for (Arc::Index a = node_begin(i); a < node_end(i); a++) {
-    Node::Index j = adj[a];
+#if GECKO_WITH_OPENMP
+  vector<WeightedValue>& v = arena->values[arena->thread()];
+#else
+  vector<WeightedValue>& v = arena->value;
+#endif
+  v.clear();
+  for (typename Arc::Index a = node_begin(i); a < node_end(i); a++) {
+    typename Node::Index j = adj[a];
     if (placed(j))
-      v.push_back(WeightedValue(node[j].pos, weight[a]));
+      v.push_back(WeightedValue(pos[j], arc_weight(a)));
   }
   return v.empty() ? -1 : functional->optimum(v);
 }
 
-// Compute coarse graph with roughly half the number of nodes.
-Graph*
-Graph::coarsen()
+// Is node i near a change to the layout?  Without active sets, all nodes
+// are considered active.
+template <typename I>
+bool
+BasicGraph<I>::active(typename Node::Index i) const
 {
-  progress->beginphase(this, string("coarse"));
-  Graph* g = new Graph(0, level - 1);
-  g->functional = functional;
-  g->progress = progress;
+#if GECKO_WITH_ACTIVE_SET
+  return arena->dirty[i] != 0;
+#else
+  (void)i;
+  return true;
+#endif
+}
 
+#if GECKO_WITH_ACTIVE_SET
+// Activate the nodes near changes to the layout since the end of the last
+// V-cycle at this level, i.e., nodes with an arc whose length has changed
+// and nodes near the last window changes.  All nodes are active when this
+// level has no such history, e.g., because its graph has been recoarsened.
+template <typename I>
+void
+BasicGraph<I>::activate()
+{
+  vector<char>& dirty = arena->dirty;
+  vector<char>& pending = arena->pending[level];
+  const vector<Float>& settled = arena->settled[level];
+  if (settled.size() == pos.size()) {
+    if (pending.size() == pos.size())
+      dirty.swap(pending);
+    else
+      dirty.assign(pos.size(), 0);
+    touch(dirty, settled);
+  }
+  else
+    dirty.assign(pos.size(), 1);
+  pending.clear();
+}
+
+// Mark the nodes with an arc whose signed length differs from that given
+// by positions p.  Lengths are compared rather than positions, as a change
+// in one place shifts all nodes that follow.  Each node sets only its own
+// mark, such that nodes may be visited concurrently.
+template <typename I>
+void
+BasicGraph<I>::touch(vector<char>& mark, const vector<Float>& p) const
+{
+#if GECKO_WITH_OPENMP
+  #pragma omp parallel for num_threads(arena->threads)
+#endif
+  for (long k = 1; k < long(pos.size()); k++) {
+    typename Node::Index i = typename Node::Index(k);
+    for (typename Arc::Index a = node_begin(i); a < node_end(i) && !mark[i]; a++) {
+      typename Node::Index j = adj[a];
+      if (pos[j] - pos[i] != p[j] - p[i])
+        mark[i] = 1;
+    }
+  }
+}
+#endif
+
+
+// Select nodes of fine graph that remain in coarse graph g and compute
+// interpolation weights for the remaining nodes.
+template <typename I>
+void
+BasicGraph<I>::aggregate(BasicGraph* g)
+{
+  vector<typename Node::Index>& child = arena->child;
+  child.assign(1, Node::null);
+#if GECKO_WITH_OPENMP
   // Compute importance of nodes in fine graph.
-  DynamicHeap<Node::Index, Float> heap;
-  for (Node::Index i = 1; i < node.size(); i++) {
-    node[i].parent = Node::null;
+  vector<Float>& w = arena->importance;
+  vector<char>& selected = arena->selected;
+  vector<typename Node::Index>& active = arena->active;
+  w.resize(pos.size());
+  selected.assign(pos.size(), 0);
+  active.resize(pos.size() - 1);
+  #pragma omp parallel for num_threads(arena->threads)
+  for (long k = 0; k < long(active.size()); k++) {
+    typename Node::Index i = typename Node::Index(k + 1);
+    parent[i] = Node::null;
+    w[i] = 0;
+    for (typename Arc::Index a = node_begin(i); a < node_end(i); a++)
+      w[i] += bond[arc_edge(a)];
+    active[k] = i;
+  }
+
+  // Select set of important nodes in rounds.  Each round selects the
+  // undecided nodes that precede all of their undecided neighbors, which
+  // are thus pairwise nonadjacent, and reduces the importance of their
+  // neighbors.  Nodes of negative importance are left out, as in the
+  // sequential scheme.  Coarse nodes are numbered by round and fine node
+  // index and thus do not depend on the number of threads.
+  while (!active.empty()) {
+    #pragma omp parallel for num_threads(arena->threads)
+    for (long k = 0; k < long(active.size()); k++) {
+      typename Node::Index i = active[k];
+      bool local = true;
+      for (typename Arc::Index a = node_begin(i); a < node_end(i) && local; a++) {
+        typename Node::Index j = adj[a];
+        if (parent[j] == Node::null && w[j] >= 0 && precedes(w, j, i))
+          local = false;
+      }
+      selected[i] = local;
+    }
+
+    // Reduce importance of neighbors.
+    #pragma omp parallel for num_threads(arena->threads)
+    for (long k = 0; k < long(active.size()); k++) {
+      typename Node::Index i = active[k];
+      if (!selected[i])
+        for (typename Arc::Index a = node_begin(i); a < node_end(i); a++)
+          if (selected[adj[a]])
+            w[i] -= 2 * bond[arc_edge(a)];
+    }
+
+    // Insert selected nodes into coarse graph.
+    size_t m = 0;
+    for (size_t k = 0; k < active.size(); k++) {
+      typename Node::Index i = active[k];
+      if (selected[i]) {
+        selected[i] = 0;
+        child.push_back(i);
+        parent[i] = g->insert_node(2 * hlen[i]);
+      }
+      else if (w[i] >= 0)
+        active[m++] = i;
+    }
+    active.resize(m);
+  }
+#else
+  // Compute importance of nodes in fine graph.
+  DynamicHeap<typename Node::Index, Float, std::less<Float>, typename Node::Index>& heap = arena->heap;
+  heap.clear();
+  for (typename Node::Index i = 1; i < pos.size(); i++) {
+    parent[i] = Node::null;
     Float w = 0;
-    for (Arc::Index a = node_begin(i); a < node_end(i); a++)
-      w += bond[a];
+    for (typename Arc::Index a = node_begin(i); a < node_end(i); a++)
+      w += bond[arc_edge(a)];
     heap.insert(i, w);
   }
 
   // Select set of important nodes from fine graph that will remain in
   // coarse graph.
-  vector<Node::Index> child(1, Node::null);
   while (!heap.empty()) {
-    Node::Index i;
+    typename Node::Index i;
     Float w = 0;
     heap.extract(i, w);
     if (w < 0)
       break;
     child.push_back(i);
-    node[i].parent = g->insert_node(2 * node[i].hlen);
+    parent[i] = g->insert_node(2 * hlen[i]);
 
     // Reduce importance of neighbors.
-    for (Arc::Index a = node_begin(i); a < node_end(i); a++) {
-      Node::Index j = adj[a];
+    for (typename Arc::Index a = node_begin(i); a < node_end(i); a++) {
+      typename Node::Index j = adj[a];
       if (heap.find(j, w))
-        heap.update(j, w - 2 * bond[a]);
+        heap.update(j, w - 2 * bond[arc_edge(a)]);
     }
   }
+#endif
 
   // Assign parts of remaining nodes to aggregates.
-  vector<Float> part = bond;
-  for (Node::Index i = 1; i < node.size(); i++)
+  vector<Float>& part = arena->part[level - 1];
+  part.resize(adj.size());
+  for (typename Arc::Index a = 0; a < adj.size(); a++)
+    part[a] = bond[arc_edge(a)];
+#if GECKO_WITH_OPENMP
+  #pragma omp parallel for num_threads(arena->threads)
+#endif
+  for (long k = 1; k < long(pos.size()); k++) {
+    typename Node::Index i = typename Node::Index(k);
     if (!persistent(i)) {
       // Find all connections to coarse nodes.
       Float w = 0;
       Float max = 0;
-      for (Arc::Index a = node_begin(i); a < node_end(i); a++) {
-        Node::Index j = adj[a];
+      for (typename Arc::Index a = node_begin(i); a < node_end(i); a++) {
+        typename Node::Index j = adj[a];
         if (persistent(j)) {
           w += part[a];
           if (max < part[a])
@@ -298,48 +847,202 @@ Graph::coarsen()
       max /= GECKO_PART_FRAC;
 
       // Weed out insignificant connections.
-      for (Arc::Index a = node_begin(i); a < node_end(i); a++)
+      for (typename Arc::Index a = node_begin(i); a < node_end(i); a++)
         if (0 < part[a] && part[a] < max) {
           w -= part[a];
           part[a] = -1;
         }
 
-      // Compute node fractions (interpolation matrix) and assign
-      // partial nodes to aggregates.
-      for (Arc::Index a = node_begin(i); a < node_end(i); a++)
-        if (part[a] > 0) {
+      // Compute node fractions (interpolation matrix).
+      for (typename Arc::Index a = node_begin(i); a < node_end(i); a++)
+        if (part[a] > 0)
           part[a] /= w;
-          Node::Index p = node[adj[a]].parent;
-          g->node[p].hlen += part[a] * node[i].hlen;
-        }
     }
+  }
+  aggregate_lengths(g);
+}
 
-  // Transfer arcs to coarse graph.
-  for (Node::Index p = 1; p < g->node.size(); p++) {
-    Node::Index i = child[p];
-    for (Arc::Index a = node_begin(i); a < node_end(i); a++) {
-      transfer(g, part, p, a);
-      Node::Index j = adj[a];
-      if (!persistent(j)) {
-        Arc::Index b = arc_index(j, i);
-        if (part[b] > 0)
-          for (Arc::Index c = node_begin(j); c < node_end(j); c++) {
-            Node::Index k = adj[c];
-            if (k != i)
-              transfer(g, part, p, c, part[b]);
-          }
+// Assign partial nodes to aggregates by adding their interpolated lengths
+// to the lengths of coarse nodes, which must be initialized to those of
+// their fine nodes.  In parallel, each coarse node gathers the lengths of
+// its partial nodes via reverse arcs.
+template <typename I>
+void
+BasicGraph<I>::aggregate_lengths(BasicGraph* g) const
+{
+  const vector<Float>& part = arena->part[level - 1];
+#if GECKO_WITH_OPENMP
+  const vector<typename Node::Index>& child = arena->child;
+  #pragma omp parallel for num_threads(arena->threads)
+  for (long k = 1; k < long(g->pos.size()); k++) {
+    typename Node::Index p = typename Node::Index(k);
+    typename Node::Index i = child[p];
+    for (typename Arc::Index a = node_begin(i); a < node_end(i); a++) {
+      typename Node::Index j = adj[a];
+      typename Arc::Index b = twin[a];
+      if (!persistent(j) && part[b] > 0)
+        g->hlen[p] += part[b] * hlen[j];
+    }
+  }
+#else
+  for (typename Node::Index i = 1; i < pos.size(); i++)
+    if (!persistent(i))
+      for (typename Arc::Index a = node_begin(i); a < node_end(i); a++)
+        if (part[a] > 0)
+          g->hlen[parent[adj[a]]] += part[a] * hlen[i];
+#endif
+}
+
+// Compute coarse graph with roughly half the number of nodes.
+template <typename I>
+BasicGraph<I>*
+BasicGraph<I>::coarsen()
+{
+  progress->beginphase(this, string("coarse"));
+  BasicGraph*& g = arena->graph[level - 1];
+  vector<Float>& part = arena->part[level - 1];
+  vector<typename Node::Index>& child = arena->child;
+  bool reuse = arena->reuse && level - 1 >= arena->valid;
+  if (reuse) {
+    // Keep aggregates and interpolation sparsity from previous V-cycle,
+    // renormalize interpolation weights using current bonds, and reset
+    // coarse layout, weights, and bonds.
+    child.assign(g->pos.size(), Node::null);
+    for (typename Node::Index i = 1; i < pos.size(); i++)
+      if (persistent(i)) {
+        child[parent[i]] = i;
+        g->hlen[parent[i]] = hlen[i];
+      }
+#if GECKO_WITH_OPENMP
+    #pragma omp parallel for num_threads(arena->threads)
+#endif
+    for (long k = 1; k < long(pos.size()); k++) {
+      typename Node::Index i = typename Node::Index(k);
+      if (!persistent(i)) {
+        Float w = 0;
+        for (typename Arc::Index a = node_begin(i); a < node_end(i); a++)
+          if (part[a] > 0)
+            w += bond[arc_edge(a)];
+        for (typename Arc::Index a = node_begin(i); a < node_end(i); a++)
+          if (part[a] > 0)
+            part[a] = bond[arc_edge(a)] / w;
+      }
+    }
+    aggregate_lengths(g);
+    for (typename Node::Index p = 1; p < g->pos.size(); p++) {
+      g->perm[p - 1] = p;
+      g->pos[p] = -1;
+    }
+    std::fill(g->weight.begin(), g->weight.end(), Float(0));
+    std::fill(g->bond.begin(), g->bond.end(), Float(0));
+  }
+  else {
+    // Recycle coarse graph from previous V-cycle if available, and
+    // invalidate the aggregates of all coarser levels.
+    if (!g)
+      g = new BasicGraph(0, level - 1);
+    g->reset(level - 1, shared_weights());
+    g->reserve(nodes(), adj.size());
+    g->functional = functional;
+    g->progress = progress;
+    g->arena = arena;
+    arena->valid = level - 1;
+#if GECKO_WITH_OPENMP
+    arena->coloring[level - 1].clear();
+#endif
+#if GECKO_WITH_ACTIVE_SET
+    arena->settled[level - 1].clear();
+#endif
+    aggregate(g);
+  }
+
+  // Transfer arcs to coarse graph one node p at a time.  Arcs (p, q) are
+  // located via marker arrays indexed by q, which are seeded with the
+  // existing arcs of p when reusing aggregates and otherwise with the
+  // reverse arcs (q, p), q < p, queued on p while accumulating node q.
+  vector<typename Arc::Index>& mark = arena->mark;
+  vector<typename Arc::Index>& rev = arena->rev;
+  vector<typename Arc::Index>& head = arena->head;
+  vector<typename Arc::Index>& next = arena->next;
+  vector<typename Node::Index>& from = arena->from;
+  mark.assign(g->pos.size(), Arc::null);
+  rev.assign(g->pos.size(), Arc::null);
+  head.assign(g->pos.size(), Arc::null);
+#if GECKO_WITH_OPENMP
+  // Gather the arcs of blocks of consecutive coarse nodes in parallel into
+  // separate buffers, from which they are appended below in node order.
+  vector<Rows<I> >& rows = arena->rows;
+  size_t n = g->nodes();
+  size_t block = std::max(size_t(1), (n + 8 * arena->threads - 1) / (8 * arena->threads));
+  long blocks = long((n + block - 1) / block);
+  if (rows.size() < size_t(blocks))
+    rows.resize(blocks);
+  arena->marks.resize(arena->threads);
+  #pragma omp parallel num_threads(arena->threads)
+  {
+    vector<typename Arc::Index>& m = arena->marks[arena->thread()];
+    m.assign(g->pos.size(), Arc::null);
+    #pragma omp for schedule(dynamic)
+    for (long b = 0; b < blocks; b++) {
+      Rows<I>& r = rows[b];
+      r.clear(&m);
+      for (size_t p = size_t(b) * block + 1; p <= std::min(size_t(b + 1) * block, n); p++) {
+        gather(&r, part, typename Node::Index(p));
+        r.finish();
       }
     }
   }
+#endif
+  for (typename Node::Index p = 1; p < g->pos.size(); p++) {
+    if (reuse)
+      for (typename Arc::Index b = g->node_begin(p); b < g->node_end(p); b++)
+        mark[g->adj[b]] = b;
+    else
+      for (typename Arc::Index b = head[p]; b != Arc::null; b = next[b])
+        rev[from[b]] = b;
+    typename Arc::Index begin = typename Arc::Index(g->adj.size());
+#if GECKO_WITH_OPENMP
+    const Rows<I>& r = rows[(p - 1) / block];
+    size_t k = (p - 1) % block;
+    for (size_t e = r.begin(k); e < r.end[k]; e++)
+      g->update(p, r.target[e], r.weight[e], r.bond[e]);
+#else
+    gather(g, part, p);
+#endif
+
+    // Reset markers and queue new arcs (p, q), q > p, on q.
+    if (reuse)
+      for (typename Arc::Index b = g->node_begin(p); b < g->node_end(p); b++)
+        mark[g->adj[b]] = Arc::null;
+    else {
+      typename Arc::Index end = typename Arc::Index(g->adj.size());
+      next.resize(end);
+      from.resize(end);
+      for (typename Arc::Index b = begin; b < end; b++) {
+        typename Node::Index q = g->adj[b];
+        mark[q] = Arc::null;
+        if (q > p) {
+          next[b] = head[q];
+          head[q] = b;
+          from[b] = p;
+        }
+      }
+      for (typename Arc::Index b = head[p]; b != Arc::null; b = next[b])
+        rev[from[b]] = Arc::null;
+    }
+  }
 
 #if DEBUG
   if (g->directed())
     throw runtime_error("directed edge found");
 #endif
 
-  // Free memory.
-  vector<Float> t = bond;
-  bond.swap(t);
+  // Shared edges have accumulated contributions from both of their arcs.
+  if (g->shared_weights())
+    for (typename Edge::Index e = 1; e < g->weight.size(); e++) {
+      g->weight[e] /= 2;
+      g->bond[e] /= 2;
+    }
 
   progress->endphase(this, false);
 
@@ -347,25 +1050,31 @@ Graph::coarsen()
 }
 
 // Order nodes according to coarsened graph layout.
+template <typename I>
 void
-Graph::refine(const Graph* graph)
+BasicGraph<I>::refine(const BasicGraph* graph)
 {
   progress->beginphase(this, string("refine"));
 
   // Place persistent nodes.
-  DynamicHeap<Node::Index, Float> heap;
-  for (Node::Index i = 1; i < node.size(); i++)
+#if GECKO_WITH_BUCKET_QUEUE
+  BucketQueue<typename Node::Index, Float>& heap = arena->queue;
+#else
+  DynamicHeap<typename Node::Index, Float, std::less<Float>, typename Node::Index>& heap = arena->heap;
+#endif
+  heap.clear();
+  for (typename Node::Index i = 1; i < pos.size(); i++)
     if (persistent(i)) {
-      Node::Index p = node[i].parent;
-      node[i].pos = graph->node[p].pos;
+      typename Node::Index p = parent[i];
+      pos[i] = graph->pos[p];
     }
     else {
-      node[i].pos = -1;
+      pos[i] = -1;
       Float w = 0;
-      for (Arc::Index a = node_begin(i); a < node_end(i); a++) {
-        Node::Index j = adj[a];
+      for (typename Arc::Index a = node_begin(i); a < node_end(i); a++) {
+        typename Node::Index j = adj[a];
         if (persistent(j))
-          w += weight[a];
+          w += arc_weight(a);
       }
       heap.insert(i, w);
     }
@@ -373,14 +1082,14 @@ Graph::refine(const Graph* graph)
   // Place remaining nodes in order of decreasing connectivity with
   // already placed nodes.
   while (!heap.empty()) {
-    Node::Index i = 0;
+    typename Node::Index i = 0;
     heap.extract(i);
-    node[i].pos = optimal(i);
-    for (Arc::Index a = node_begin(i); a < node_end(i); a++) {
-      Node::Index j = adj[a];
+    pos[i] = optimal(i);
+    for (typename Arc::Index a = node_begin(i); a < node_end(i); a++) {
+      typename Node::Index j = adj[a];
       Float w;
       if (heap.find(j, w))
-        heap.update(j, w + weight[a]);
+        heap.update(j, w + arc_weight(a));
     }
   }
 
@@ -388,126 +1097,372 @@ Graph::refine(const Graph* graph)
   progress->endphase(this, true);
 }
 
-// Perform m sweeps of compatible or Gauss-Seidel relaxation.
+#if GECKO_WITH_OPENMP
+// Partition nodes into independent sets.  In each round, the uncolored
+// nodes that precede all of their uncolored neighbors in pseudorandom
+// order are assigned the next color.
+template <typename I>
+void
+BasicGraph<I>::color()
+{
+  Coloring<I>& coloring = arena->coloring[level];
+  vector<uint>& color = arena->color;
+  vector<char>& selected = arena->selected;
+  vector<typename Node::Index>& active = arena->active;
+  coloring.clear();
+  color.assign(pos.size(), uint(-1));
+  selected.assign(pos.size(), 0);
+  active.resize(pos.size() - 1);
+  for (typename Node::Index i = 1; i < pos.size(); i++)
+    active[i - 1] = i;
+  while (!active.empty()) {
+    uint c = uint(coloring.colors());
+    #pragma omp parallel for num_threads(arena->threads)
+    for (long k = 0; k < long(active.size()); k++) {
+      typename Node::Index i = active[k];
+      bool local = true;
+      for (typename Arc::Index a = node_begin(i); a < node_end(i) && local; a++) {
+        typename Node::Index j = adj[a];
+        if (color[j] == uint(-1) && precedes(j, i))
+          local = false;
+      }
+      selected[i] = local;
+    }
+    size_t m = 0;
+    for (size_t k = 0; k < active.size(); k++) {
+      typename Node::Index i = active[k];
+      if (selected[i]) {
+        selected[i] = 0;
+        color[i] = c;
+        coloring.node.push_back(i);
+      }
+      else
+        active[m++] = i;
+    }
+    active.resize(m);
+    coloring.end.push_back(coloring.node.size());
+  }
+}
+#endif
+
+// Perform m sweeps of compatible or Gauss-Seidel relaxation.  With OpenMP,
+// nodes are visited by color rather than in layout order.
+template <typename I>
 void
-Graph::relax(bool compatible, uint m)
+BasicGraph<I>::relax(bool compatible, uint m)
 {
   progress->beginphase(this, compatible ? string("crelax") : string("frelax"));
+#if GECKO_WITH_ACTIVE_SET
+  arena->prior = pos;
+#endif
+  size_t relaxed = 0;
+  size_t unrelaxed = 0;
+#if GECKO_WITH_OPENMP
+  // Relax one color at a time, whose nodes are mutually independent.
+  const Coloring<I>& coloring = arena->coloring[level];
+  if (coloring.empty())
+    color();
+  while (m--)
+    for (size_t c = 0; c < coloring.colors() && !progress->quit(); c++) {
+      #pragma omp parallel for num_threads(arena->threads) schedule(dynamic, 64) reduction(+:relaxed, unrelaxed)
+      for (long k = long(coloring.begin(c)); k < long(coloring.end[c]); k++) {
+        typename Node::Index i = coloring.node[k];
+        if (!compatible || !persistent(i)) {
+          if (active(i)) {
+            pos[i] = optimal(i);
+            relaxed++;
+          }
+          else
+            unrelaxed++;
+        }
+      }
+    }
+#else
   while (m--)
-    for (uint k = 0; k < perm.size() && !progress->quit(); k++) {
-      Node::Index i = perm[k];
-      if (!compatible || !persistent(i))
-        node[i].pos = optimal(i);
+    for (I k = 0; k < perm.size() && !progress->quit(); k++) {
+      typename Node::Index i = perm[k];
+      if (!compatible || !persistent(i)) {
+        if (active(i)) {
+          pos[i] = optimal(i);
+          relaxed++;
+        }
+        else
+          unrelaxed++;
+      }
     }
+#endif
   place(true);
+#if GECKO_WITH_ACTIVE_SET
+  touch(arena->dirty, arena->prior);
+#endif
+  arena->activity->relaxed += relaxed;
+  arena->activity->unrelaxed += unrelaxed;
   progress->endphase(this, true);
 }
 
 // Optimize successive n-node subgraphs.
+template <typename I>
 void
-Graph::optimize(uint n)
+BasicGraph<I>::optimize(uint n)
 {
   if (n > perm.size())
     n = uint(perm.size());
   ostringstream count;
   count << setw(2) << n;
   progress->beginphase(this, string("perm") + count.str());
-  Subgraph* subgraph = new Subgraph(this, n);
-  for (uint k = 0; k <= perm.size() - n && !progress->quit(); k++)
-    subgraph->optimize(k);
-  delete subgraph;
+#if GECKO_WITH_ACTIVE_SET
+  arena->prior = pos;
+#endif
+  // Dispatch to the windows specialized for the functional's policy and
+  // for n nodes.  Rows follow the order of policies.  Sizes above
+  // GECKO_WINDOW_MAX do not occur and map to the largest size so as not
+  // to be instantiated.
+  #define GECKO_WINDOWS(F, n) &BasicGraph::template optimize<F, ((n) < GECKO_WINDOW_MAX ? (n) : GECKO_WINDOW_MAX)>
+  #define GECKO_POLICY(F) { \
+    0, \
+    GECKO_WINDOWS(F, 1), GECKO_WINDOWS(F, 2), GECKO_WINDOWS(F, 3), GECKO_WINDOWS(F, 4), \
+    GECKO_WINDOWS(F, 5), GECKO_WINDOWS(F, 6), GECKO_WINDOWS(F, 7), GECKO_WINDOWS(F, 8), \
+    GECKO_WINDOWS(F, 9), GECKO_WINDOWS(F, 10), GECKO_WINDOWS(F, 11), GECKO_WINDOWS(F, 12), \
+    GECKO_WINDOWS(F, 13), GECKO_WINDOWS(F, 14), GECKO_WINDOWS(F, 15), GECKO_WINDOWS(F, 16), \
+  }
+  typedef void (BasicGraph::*Windows)();
+  static const Windows windows[policies][17] = {
+    GECKO_POLICY(Functional),
+    GECKO_POLICY(UnitHarmonic),
+    GECKO_POLICY(UnitGeometric),
+    GECKO_POLICY(UnitArithmetic),
+#if GECKO_LENGTH_TABLE
+    GECKO_POLICY(TabulatedGeometric),
+#endif
+  };
+  #undef GECKO_POLICY
+  #undef GECKO_WINDOWS
+  uint policy = arena->policy;
+#if GECKO_LENGTH_TABLE
+  // Look up logarithms of edge lengths when all nodes have integer length,
+  // as on the finest level of unit-length graphs.  Coarse nodes rarely do,
+  // and would only pay for failed lookups.
+  if (policy == policy_geometric) {
+    typename Node::Index i = 1;
+    while (i < hlen.size() && std::floor(2 * hlen[i]) == 2 * hlen[i])
+      i++;
+    if (i == hlen.size())
+      policy = policy_tabulated;
+  }
+#endif
+  if (n)
+    (this->*windows[policy][n])();
+#if GECKO_WITH_ACTIVE_SET
+  // Windows already passed have not seen the changes made by those that
+  // followed, so carry the nodes near changes over to the next V-cycle.
+  vector<char>& pending = arena->pending[level];
+  pending.assign(pos.size(), 0);
+  touch(pending, arena->prior);
+#endif
   progress->endphase(this, true);
 }
 
+// Optimize successive N-node subgraphs.
+template <typename I>
+template <class F, uint N>
+void
+BasicGraph<I>::optimize()
+{
+  const uint n = N;
+  size_t optimized = 0;
+  size_t unoptimized = 0;
+#if GECKO_WITH_OPENMP
+  // Divide the window positions into segments of consecutive positions,
+  // which are processed in two phases: first all even and then all odd
+  // segments.  The windows of one segment are optimized sequentially, and
+  // those of the segments in a phase concurrently, as they lie far enough
+  // apart not to overlap.  Positions of nodes in other segments are taken
+  // from the start of the phase.  The segment length is fixed so that
+  // layouts do not depend on the number of threads.
+  const size_t span = std::max(size_t(n), size_t(1024));
+  size_t windows = perm.size() - n + 1;
+  long segments = long((windows + span - 1) / span);
+  vector<Float>& frozen = arena->frozen;
+  vector<typename Node::Index>& rank = arena->rank;
+  for (long phase = 0; phase < 2 && !progress->quit(); phase++) {
+    if (segments > 1) {
+      frozen = pos;
+      rank.resize(pos.size());
+      for (I k = 0; k < perm.size(); k++)
+        rank[perm[k]] = k;
+    }
+    #pragma omp parallel num_threads(arena->threads)
+    {
+      Subgraph<I, N, F> subgraph(this, arena->thread());
+      #pragma omp for schedule(dynamic) reduction(+:optimized, unoptimized)
+      for (long s = phase; s < segments; s += 2) {
+        I begin = I(s * span);
+        I end = I(std::min(begin + span, windows));
+        if (segments > 1)
+          subgraph.freeze(&frozen[0], &rank[0], begin, I(end + n - 1));
+        for (I k = begin; k < end; k++) {
+          if (optimize(subgraph, k))
+            optimized++;
+          else
+            unoptimized++;
+        }
+      }
+    }
+  }
+#else
+  Subgraph<I, N, F> subgraph(this);
+  for (I k = 0; k <= perm.size() - n && !progress->quit(); k++) {
+    if (optimize(subgraph, k))
+      optimized++;
+    else
+      unoptimized++;
+  }
+#endif
+  arena->activity->optimized += optimized;
+  arena->activity->unoptimized += unoptimized;
+}
+
+// Optimize the window of N nodes starting at position k unless none of
+// its nodes is active, and report whether it was optimized.  The nodes of
+// a window whose layout changes become active, such that the overlapping
+// windows that follow are optimized, too.
+template <typename I>
+template <class F, uint N>
+bool
+BasicGraph<I>::optimize(Subgraph<I, N, F>& subgraph, I k)
+{
+  uint m = 0;
+  while (m < N && !active(perm[k + m]))
+    m++;
+  if (m == N)
+    return false;
+#if GECKO_WITH_ACTIVE_SET
+  if (subgraph.optimize(k))
+    for (m = 0; m < N; m++)
+      arena->dirty[perm[k + m]] = 1;
+#else
+  subgraph.optimize(k);
+#endif
+  return true;
+}
+
 // Place all nodes according to their positions.
+template <typename I>
 void
-Graph::place(bool sort)
+BasicGraph<I>::place(bool sort)
 {
-  place(sort, 0, uint(perm.size()));
+  place(sort, 0, I(perm.size()));
 }
 
 // Place nodes {k, ..., k + n - 1} according to their positions.
+template <typename I>
 void
-Graph::place(bool sort, uint k, uint n)
+BasicGraph<I>::place(bool sort, I k, I n)
 {
   // Place nodes.
   if (sort)
-    stable_sort(perm.begin() + k, perm.begin() + k + n, Node::Comparator(node.begin()));
+    stable_sort(perm.begin() + k, perm.begin() + k + n, typename Node::Comparator(pos.begin()));
 
   // Assign node positions according to permutation.
-  for (Float p = k ? node[perm[k - 1]].pos + node[perm[k - 1]].hlen : 0; n--; k++) {
-    Node::Index i = perm[k];
-    p += node[i].hlen;
-    node[i].pos = p;
-    p += node[i].hlen;
+  for (Float p = k ? pos[perm[k - 1]] + hlen[perm[k - 1]] : 0; n--; k++) {
+    typename Node::Index i = perm[k];
+    p += hlen[i];
+    pos[i] = p;
+    p += hlen[i];
   }
 }
 
 // Perform one V-cycle.
+template <typename I>
 void
-Graph::vcycle(uint n, uint work)
+BasicGraph<I>::vcycle(uint n, size_t work)
 {
+  if (twin.size() != adj.size())
+    twin_arcs();
   if (n < nodes() && nodes() < edges() && level && !progress->quit()) {
-    Graph* graph = coarsen();
+    BasicGraph* graph = coarsen();
     graph->vcycle(n, work + edges());
     refine(graph);
-    delete graph;
   }
   else
     place();
   if (edges()) {
+#if GECKO_WITH_ACTIVE_SET
+    activate();
+#endif
     relax(true, GECKO_CR_SWEEPS);
     relax(false, GECKO_GS_SWEEPS);
-    for (uint w = edges(); w * (n + 1) < work; w *= ++n);
+    for (size_t w = edges(); w * (n + 1) < work; w *= ++n);
     n = std::min(n, uint(GECKO_WINDOW_MAX));
     if (n)
       optimize(n);
+#if GECKO_WITH_ACTIVE_SET
+    arena->settled[level] = pos;
+#endif
   }
 }
 
-// Custom random-number generator for reproducibility.
+// Custom random-number generator for reproducibility.  Each graph has its
+// own state, such that graphs may be ordered concurrently.
 // LCG from doi:10.1090/S0025-5718-99-00996-5.
+template <typename I>
 uint
-Graph::random(uint seed)
+BasicGraph<I>::random(uint seed)
 {
-  static uint state = 1;
   state = (seed ? seed : 0x1ed0675 * state + 0xa14f);
   return state;
 }
 
 // Generate a random permutation of the nodes.
+template <typename I>
 void
-Graph::shuffle(uint seed)
+BasicGraph<I>::shuffle(uint seed)
 {
   random(seed);
-  for (uint k = 0; k < perm.size(); k++) {
+  for (I k = 0; k < perm.size(); k++) {
     uint r = random() >> 8;
-    uint l = k + r % (uint(perm.size()) - k);
+    I l = k + r % (I(perm.size()) - k);
     std::swap(perm[k], perm[l]);
   }
   place();
 }
 
 // Recompute bonds for k'th V-cycle.
+template <typename I>
 void
-Graph::reweight(uint k)
+BasicGraph<I>::reweight(uint k)
 {
-  bond.resize(weight.size());
-  for (Arc::Index a = 1; a < adj.size(); a++)
-    bond[a] = functional->bond(weight[a], length(a), k);
+  if (shared_weights()) {
+    // Compute one bond per edge.
+    for (typename Arc::Index a = 1; a < adj.size(); a++)
+      if (a < twin[a])
+        bond[edge[a]] = functional->bond(arc_weight(a), length(a), k);
+  }
+  else {
+    bond.resize(adj.size());
+    for (typename Arc::Index a = 1; a < adj.size(); a++)
+      bond[a] = functional->bond(arc_weight(a), length(a), k);
+  }
 }
 
 // Linearly order graph.
+template <typename I>
 void
-Graph::order(Functional* functional, uint iterations, uint window, uint period, uint seed, Progress* progress)
+BasicGraph<I>::order(Functional* functional, uint iterations, uint window, uint period, uint seed, Progress* progress)
 {
   // Initialize graph.
+  bool local = !progress;
   this->functional = functional;
-  progress = this->progress = progress ? progress : new Progress;
-  for (level = 0; (1u << level) < nodes(); level++);
+  progress = this->progress = local ? new Progress : progress;
+  for (level = 0; (I(1) << level) < nodes(); level++);
+  Arena<I> arena(level, nodes(), adj.size(), thread_count);
+  this->arena = &arena;
+  tally = Activity();
+  arena.activity = &tally;
+  arena.policy = policy(functional);
   place();
   Float mincost = cost();
-  vector<Node::Index> minperm = perm;
+  vector<typename Node::Index> minperm = perm;
   if (seed)
     shuffle(seed);
 
@@ -516,7 +1471,23 @@ Graph::order(Functional* functional, uint iterations, uint window, uint period,
     // Perform specified number of V-cycles.
     for (uint k = 1; k <= iterations && !progress->quit(); k++) {
       progress->beginiter(this, k, iterations, window);
+      progress->beginphase(this, string("reweight"));
       reweight(k);
+      if (GECKO_RECOARSEN_TOL > 0) {
+        // Reuse multilevel hierarchy unless bonds have changed appreciably
+        // since it was last built.
+        Float change = 0;
+        Float total = 0;
+        if (arena.bond.size() == bond.size())
+          for (size_t e = 1; e < bond.size(); e++) {
+            change += fabs(bond[e] - arena.bond[e]);
+            total += fabs(arena.bond[e]);
+          }
+        arena.reuse = total > 0 && change <= Float(GECKO_RECOARSEN_TOL) * total;
+        if (!arena.reuse)
+          arena.bond = bond;
+      }
+      progress->endphase(this, false);
       vcycle(window);
       Float c = cost();
       if (c < mincost) { 
@@ -531,9 +1502,83 @@ Graph::order(Functional* functional, uint iterations, uint window, uint period,
     place();
   }
   progress->endorder(this, mincost);
+  this->arena = 0;
 
-  if (!progress) {
+  if (local) {
     delete this->progress;
     this->progress = 0;
   }
 }
+
+// Progress reporter for ensemble members, which forwards only requests to
+// quit.
+template <typename I>
+class EnsembleProgress : public BasicProgress<I> {
+public:
+  EnsembleProgress(const BasicProgress<I>* progress) : progress(progress) {}
+  bool quit() const { return progress && progress->quit(); }
+private:
+  const BasicProgress<I>* progress;
+};
+
+// Order copies of graph using different seeds and keep the best ordering.
+template <typename I>
+uint
+BasicGraph<I>::order(Functional* functional, const vector<uint>& seeds, vector<Float>& costs, uint iterations, uint window, uint period, Progress* progress)
+{
+  costs.assign(seeds.size(), GECKO_FLOAT_MAX);
+  if (seeds.empty())
+    return 0;
+
+  // Pair arcs once so that the copies need not.
+  this->functional = functional;
+  if (twin.size() != adj.size())
+    twin_arcs();
+  place();
+  if (progress)
+    progress->beginorder(this, cost());
+
+  // Order one copy per seed, each using a single thread, and keep the
+  // ordering of lowest cost, with ties resolved in favor of earlier seeds.
+  vector<vector<typename Node::Index> > perms(seeds.size());
+  vector<Activity> work(seeds.size());
+  EnsembleProgress<I> quit(progress);
+#if GECKO_WITH_OPENMP
+  int threads = thread_count ? int(thread_count) : omp_get_max_threads();
+  #pragma omp parallel for num_threads(threads) schedule(dynamic, 1)
+#endif
+  for (long k = 0; k < long(seeds.size()); k++) {
+    BasicGraph copy(*this);
+    copy.set_threads(1);
+    copy.order(functional, iterations, window, period, seeds[k], &quit);
+    costs[k] = copy.cost();
+    perms[k].swap(copy.perm);
+    work[k] = copy.tally;
+  }
+
+  // Sum the work done by all copies.
+  tally = Activity();
+  for (uint k = 0; k < seeds.size(); k++) {
+    tally.relaxed += work[k].relaxed;
+    tally.unrelaxed += work[k].unrelaxed;
+    tally.optimized += work[k].optimized;
+    tally.unoptimized += work[k].unoptimized;
+  }
+  uint best = 0;
+  for (uint k = 1; k < seeds.size(); k++)
+    if (costs[k] < costs[best])
+      best = k;
+  perm.swap(perms[best]);
+  place();
+
+  if (progress)
+    progress->endorder(this, costs[best]);
+  return best;
+}
+
+// Explicit instantiations.
+namespace Gecko {
+template class BasicGraph<uint16_t>;
+template class BasicGraph<uint32_t>;
+template class BasicGraph<uint64_t>;
+}
@@ -2,20 +2,72 @@
 #define DYNAMIC_HEAP_H
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <map>
 #include <vector>
 
+// Heap position index for data in {0, ..., n - 1} stored as a dense array.
+template <typename T, typename I>
+class DenseIndex {
+public:
+  void reserve(size_t count) { if (pos.size() < count) pos.resize(count, npos()); }
+  bool find(T data, I& i) const
+  {
+    if (size_t(data) < pos.size() && pos[data] != npos()) {
+      i = pos[data];
+      return true;
+    }
+    else
+      return false;
+  }
+  void insert(T data, I i)
+  {
+    if (size_t(data) >= pos.size())
+      pos.resize(size_t(data) + 1, npos());
+    pos[data] = i;
+  }
+  void erase(T data) { pos[data] = npos(); }
+private:
+  static I npos() { return ~I(0); }
+  std::vector<I> pos;
+};
+
+// Heap position index for arbitrary ordered data stored as a map.
+template <typename T, typename I>
+class MapIndex {
+public:
+  void reserve(size_t) {}
+  bool find(T data, I& i) const
+  {
+    typename std::map<T, I>::const_iterator p = pos.find(data);
+    if (p != pos.end()) {
+      i = p->second;
+      return true;
+    }
+    else
+      return false;
+  }
+  void insert(T data, I i) { pos[data] = i; }
+  void erase(T data) { pos.erase(data); }
+private:
+  std::map<T, I> pos;
+};
+
 template <
   typename T,                             // data type
   typename P,                             // priority type
   class    C = std::less<P>,              // comparator for priorities
-  class    M = std::map<T, unsigned int>  // maps type T to unsigned integer
+  typename I = unsigned int,              // heap position type
+  class    M = DenseIndex<T, I>,          // maps type T to heap position
+  unsigned D = 2                          // heap arity
 >
 class DynamicHeap {
 public:
   DynamicHeap(size_t count = 0);
   ~DynamicHeap() {}
+  void reserve(size_t count);
+  void clear();
   void insert(T data, P priority);
   void update(T data, P priority);
   bool top(T& data);
@@ -37,50 +89,66 @@ private:
   std::vector<HeapEntry> heap;
   M index;
   C lower;
-  void ascend(unsigned int i);
-  void descend(unsigned int i);
-  void swap(unsigned int i, unsigned int j);
-  bool ordered(unsigned int i, unsigned int j) const
-  {
-    return !lower(heap[i].priority, heap[j].priority);
-  }
-  unsigned int parent(unsigned int i) const { return (i - 1) / 2; }
-  unsigned int left(unsigned int i) const { return 2 * i + 1; }
-  unsigned int right(unsigned int i) const { return 2 * i + 2; }
+  void ascend(I i);
+  void descend(I i);
+  I parent(I i) const { return (i - 1) / D; }
+  size_t child(I i) const { return D * size_t(i) + 1; }
 };
 
-template < typename T, typename P, class C, class M >
-DynamicHeap<T, P, C, M>::DynamicHeap(size_t count)
+template < typename T, typename P, class C, typename I, class M, unsigned D >
+DynamicHeap<T, P, C, I, M, D>::DynamicHeap(size_t count)
+{
+  reserve(count);
+}
+
+// Reserve space for data in {0, ..., count - 1}.
+template < typename T, typename P, class C, typename I, class M, unsigned D >
+void
+DynamicHeap<T, P, C, I, M, D>::reserve(size_t count)
 {
   heap.reserve(count);
+  index.reserve(count);
+}
+
+// Remove all entries while retaining storage.
+template < typename T, typename P, class C, typename I, class M, unsigned D >
+void
+DynamicHeap<T, P, C, I, M, D>::clear()
+{
+  for (size_t i = 0; i < heap.size(); i++)
+    index.erase(heap[i].data);
+  heap.clear();
 }
 
-template < typename T, typename P, class C, class M >
+template < typename T, typename P, class C, typename I, class M, unsigned D >
 void
-DynamicHeap<T, P, C, M>::insert(T data, P priority)
+DynamicHeap<T, P, C, I, M, D>::insert(T data, P priority)
 {
-  if (index.find(data) != index.end())
+  I i;
+  if (index.find(data, i))
     update(data, priority);
   else {
-    unsigned int i = (unsigned int)heap.size();
+    i = (I)heap.size();
     heap.push_back(HeapEntry(priority, data));
     ascend(i);
   }
 }
 
-template < typename T, typename P, class C, class M >
+template < typename T, typename P, class C, typename I, class M, unsigned D >
 void
-DynamicHeap<T, P, C, M>::update(T data, P priority)
+DynamicHeap<T, P, C, I, M, D>::update(T data, P priority)
 {
-  unsigned int i = index[data];
-  heap[i].priority = priority;
-  ascend(i);
-  descend(i);
+  I i;
+  if (index.find(data, i)) {
+    heap[i].priority = priority;
+    ascend(i);
+    descend(i);
+  }
 }
 
-template < typename T, typename P, class C, class M >
+template < typename T, typename P, class C, typename I, class M, unsigned D >
 bool
-DynamicHeap<T, P, C, M>::top(T& data)
+DynamicHeap<T, P, C, I, M, D>::top(T& data)
 {
   if (!heap.empty()) {
     data = heap[0].data;
@@ -90,9 +158,9 @@ DynamicHeap<T, P, C, M>::top(T& data)
     return false;
 }
 
-template < typename T, typename P, class C, class M >
+template < typename T, typename P, class C, typename I, class M, unsigned D >
 bool
-DynamicHeap<T, P, C, M>::top(T& data, P& priority)
+DynamicHeap<T, P, C, I, M, D>::top(T& data, P& priority)
 {
   if (!heap.empty()) {
     data = heap[0].data;
@@ -103,26 +171,27 @@ DynamicHeap<T, P, C, M>::top(T& data, P& priority)
     return false;
 }
 
-template < typename T, typename P, class C, class M >
+template < typename T, typename P, class C, typename I, class M, unsigned D >
 bool
-DynamicHeap<T, P, C, M>::pop()
+DynamicHeap<T, P, C, I, M, D>::pop()
 {
   if (!heap.empty()) {
-    T data = heap[0].data;
-    swap(0, (unsigned int)heap.size() - 1);
-    index.erase(data);
+    index.erase(heap[0].data);
+    HeapEntry last = heap.back();
     heap.pop_back();
-    if (!heap.empty())
+    if (!heap.empty()) {
+      heap[0] = last;
       descend(0);
+    }
     return true;
   }
   else
     return false;
 }
 
-template < typename T, typename P, class C, class M >
+template < typename T, typename P, class C, typename I, class M, unsigned D >
 bool
-DynamicHeap<T, P, C, M>::extract(T& data)
+DynamicHeap<T, P, C, I, M, D>::extract(T& data)
 {
   if (!heap.empty()) {
     data = heap[0].data;
@@ -132,9 +201,9 @@ DynamicHeap<T, P, C, M>::extract(T& data)
     return false;
 }
 
-template < typename T, typename P, class C, class M >
+template < typename T, typename P, class C, typename I, class M, unsigned D >
 bool
-DynamicHeap<T, P, C, M>::extract(T& data, P& priority)
+DynamicHeap<T, P, C, I, M, D>::extract(T& data, P& priority)
 {
   if (!heap.empty()) {
     data = heap[0].data;
@@ -145,69 +214,249 @@ DynamicHeap<T, P, C, M>::extract(T& data, P& priority)
     return false;
 }
 
-template < typename T, typename P, class C, class M >
+template < typename T, typename P, class C, typename I, class M, unsigned D >
 bool
-DynamicHeap<T, P, C, M>::erase(T data)
+DynamicHeap<T, P, C, I, M, D>::erase(T data)
 {
-  if (index.find(data) == index.end())
+  I i;
+  if (!index.find(data, i))
     return false;
-  unsigned int i = index[data];
-  swap(i, heap.size() - 1);
   index.erase(data);
+  HeapEntry last = heap.back();
   heap.pop_back();
   if (i < heap.size()) {
+    heap[i] = last;
     ascend(i);
     descend(i);
   }
   return true;
 }
 
-template < typename T, typename P, class C, class M >
+template < typename T, typename P, class C, typename I, class M, unsigned D >
 bool
-DynamicHeap<T, P, C, M>::find(T data) const
+DynamicHeap<T, P, C, I, M, D>::find(T data) const
 {
-  return index.find(data) != index.end();
+  I i;
+  return index.find(data, i);
 }
 
-template < typename T, typename P, class C, class M >
+template < typename T, typename P, class C, typename I, class M, unsigned D >
 bool
-DynamicHeap<T, P, C, M>::find(T data, P& priority) const
+DynamicHeap<T, P, C, I, M, D>::find(T data, P& priority) const
 {
-  typename M::const_iterator p;
-  if ((p = index.find(data)) == index.end())
+  I i;
+  if (!index.find(data, i))
     return false;
-  unsigned int i = p->second;
   priority = heap[i].priority;
   return true;
 }
 
-template < typename T, typename P, class C, class M >
+// Move entry i toward the root, shifting lower-priority ancestors down.
+template < typename T, typename P, class C, typename I, class M, unsigned D >
 void
-DynamicHeap<T, P, C, M>::ascend(unsigned int i)
+DynamicHeap<T, P, C, I, M, D>::ascend(I i)
 {
-  for (unsigned int j; i && !ordered(j = parent(i), i); i = j)
-    swap(i, j);
-  index[heap[i].data] = i;
+  HeapEntry e = heap[i];
+  for (I j; i && lower(heap[j = parent(i)].priority, e.priority); i = j) {
+    heap[i] = heap[j];
+    index.insert(heap[i].data, i);
+  }
+  heap[i] = e;
+  index.insert(e.data, i);
 }
 
-template < typename T, typename P, class C, class M >
+// Move entry i toward the leaves, shifting its highest-priority child up.
+template < typename T, typename P, class C, typename I, class M, unsigned D >
 void
-DynamicHeap<T, P, C, M>::descend(unsigned int i)
+DynamicHeap<T, P, C, I, M, D>::descend(I i)
 {
-  for (unsigned int j, k;
-       (j = ((k =  left(i)) < heap.size() && !ordered(i, k) ? k : i),
-        j = ((k = right(i)) < heap.size() && !ordered(j, k) ? k : j)) != i;
-       i = j)
-    swap(i, j);
-  index[heap[i].data] = i;
+  HeapEntry e = heap[i];
+  for (;;) {
+    // Find highest-priority child, if any, that precedes e.
+    I j = i;
+    const P* p = &e.priority;
+    for (size_t k = child(i), n = std::min(k + D, heap.size()); k < n; k++)
+      if (lower(*p, heap[k].priority)) {
+        j = I(k);
+        p = &heap[k].priority;
+      }
+    if (j == i)
+      break;
+    heap[i] = heap[j];
+    index.insert(heap[i].data, i);
+    i = j;
+  }
+  heap[i] = e;
+  index.insert(e.data, i);
 }
 
-template < typename T, typename P, class C, class M >
+// Approximate max-priority queue for data in {0, ..., n - 1} and
+// nonnegative priorities, which are rounded down to one of S buckets per
+// power of two.  Entries are extracted from the highest nonempty bucket in
+// last-in, first-out order.  All operations take constant amortized time.
+template <
+  typename T,                             // data type
+  typename P,                             // priority type
+  unsigned S = 4                          // buckets per power of two
+>
+class BucketQueue {
+public:
+  BucketQueue(size_t count = 0) : head(bucket_count(), npos()), high(0), count(0) { reserve(count); }
+  void reserve(size_t count);
+  void clear();
+  void insert(T data, P priority);
+  void update(T data, P priority);
+  bool extract(T& data);
+  bool extract(T& data, P& priority);
+  bool find(T data) const { return size_t(data) < node.size() && node[data].bucket != npos(); }
+  bool find(T data, P& priority) const;
+  bool empty() const { return !count; }
+  size_t size() const { return count; }
+private:
+  enum { min_exp = -64, max_exp = 64 };
+  struct Entry {
+    Entry() : bucket(npos()) {}
+    P priority;   // exact priority
+    T prev;       // previous entry in bucket
+    T next;       // next entry in bucket
+    size_t bucket; // bucket containing entry or npos if not queued
+  };
+  static size_t npos() { return ~size_t(0); }
+  static size_t bucket_count() { return 2 + size_t(max_exp - min_exp) * S; }
+  static size_t bucket(P priority);
+  void link(T data);
+  void unlink(T data);
+  std::vector<Entry> node;  // entries indexed by data
+  std::vector<T> head;      // first entry in each bucket
+  size_t high;              // upper bound on highest nonempty bucket
+  size_t count;             // number of queued entries
+};
+
+// Reserve space for data in {0, ..., count - 1}.
+template < typename T, typename P, unsigned S >
 void
-DynamicHeap<T, P, C, M>::swap(unsigned int i, unsigned int j)
+BucketQueue<T, P, S>::reserve(size_t count)
 {
-  std::swap(heap[i], heap[j]);
-  index[heap[i].data] = i;
+  if (node.size() < count)
+    node.resize(count);
+}
+
+// Remove all entries while retaining storage.
+template < typename T, typename P, unsigned S >
+void
+BucketQueue<T, P, S>::clear()
+{
+  for (size_t b = 0; b <= high; b++)
+    for (T data = head[b]; data != T(npos()); data = node[data].next)
+      node[data].bucket = npos();
+  std::fill(head.begin(), head.begin() + high + 1, T(npos()));
+  high = 0;
+  count = 0;
+}
+
+template < typename T, typename P, unsigned S >
+void
+BucketQueue<T, P, S>::insert(T data, P priority)
+{
+  if (find(data))
+    update(data, priority);
+  else {
+    reserve(size_t(data) + 1);
+    node[data].priority = priority;
+    link(data);
+    count++;
+  }
+}
+
+template < typename T, typename P, unsigned S >
+void
+BucketQueue<T, P, S>::update(T data, P priority)
+{
+  if (find(data)) {
+    unlink(data);
+    node[data].priority = priority;
+    link(data);
+  }
+}
+
+template < typename T, typename P, unsigned S >
+bool
+BucketQueue<T, P, S>::extract(T& data)
+{
+  P priority;
+  return extract(data, priority);
+}
+
+template < typename T, typename P, unsigned S >
+bool
+BucketQueue<T, P, S>::extract(T& data, P& priority)
+{
+  if (!count)
+    return false;
+  while (head[high] == T(npos()))
+    high--;
+  data = head[high];
+  priority = node[data].priority;
+  unlink(data);
+  node[data].bucket = npos();
+  count--;
+  return true;
+}
+
+template < typename T, typename P, unsigned S >
+bool
+BucketQueue<T, P, S>::find(T data, P& priority) const
+{
+  if (!find(data))
+    return false;
+  priority = node[data].priority;
+  return true;
+}
+
+// Bucket of given priority, with bucket zero reserved for priorities
+// that are not positive.
+template < typename T, typename P, unsigned S >
+size_t
+BucketQueue<T, P, S>::bucket(P priority)
+{
+  if (!(priority > 0))
+    return 0;
+  int e;
+  P m = std::frexp(priority, &e);
+  if (e < min_exp)
+    return 1;
+  if (e >= max_exp)
+    return bucket_count() - 1;
+  return 1 + size_t(e - min_exp) * S + size_t((2 * m - 1) * S);
+}
+
+// Insert entry at head of its bucket.
+template < typename T, typename P, unsigned S >
+void
+BucketQueue<T, P, S>::link(T data)
+{
+  Entry& e = node[data];
+  e.bucket = bucket(e.priority);
+  e.prev = T(npos());
+  e.next = head[e.bucket];
+  if (e.next != T(npos()))
+    node[e.next].prev = data;
+  head[e.bucket] = data;
+  high = std::max(high, e.bucket);
+}
+
+// Remove entry from its bucket.
+template < typename T, typename P, unsigned S >
+void
+BucketQueue<T, P, S>::unlink(T data)
+{
+  Entry& e = node[data];
+  if (e.prev != T(npos()))
+    node[e.prev].next = e.next;
+  else
+    head[e.bucket] = e.next;
+  if (e.next != T(npos()))
+    node[e.next].prev = e.prev;
 }
 
 #endif
@@ -9,6 +9,11 @@
   #define GECKO_PART_FRAC 4
 #endif
 
+// relative change in bonds below which aggregates are reused (0 = never)
+#ifndef GECKO_RECOARSEN_TOL
+  #define GECKO_RECOARSEN_TOL 0
+#endif
+
 // number of compatible relaxation sweeps
 #ifndef GECKO_CR_SWEEPS
   #define GECKO_CR_SWEEPS 1
@@ -24,6 +29,11 @@
   #define GECKO_WINDOW_MAX 16
 #endif
 
+// max integer and half-integer edge length whose terms are tabulated (0 = none)
+#ifndef GECKO_LENGTH_TABLE
+  #define GECKO_LENGTH_TABLE 0
+#endif
+
 // use adjacency list (1) or adjacency matrix (0)
 #ifndef GECKO_WITH_ADJLIST
   #define GECKO_WITH_ADJLIST 0
@@ -34,6 +44,31 @@
   #define GECKO_WITH_NONRECURSIVE 0
 #endif
 
+// use approximate bucket queue for refinement
+#ifndef GECKO_WITH_BUCKET_QUEUE
+  #define GECKO_WITH_BUCKET_QUEUE 0
+#endif
+
+// use OpenMP to coarsen in parallel
+#ifndef GECKO_WITH_OPENMP
+  #define GECKO_WITH_OPENMP 0
+#endif
+
+// optimize windows by dynamic programming over subsets when exact
+#ifndef GECKO_WITH_SUBSET_DP
+  #define GECKO_WITH_SUBSET_DP 0
+#endif
+
+// use vector instructions to evaluate window costs
+#ifndef GECKO_WITH_SIMD
+  #define GECKO_WITH_SIMD 0
+#endif
+
+// skip relaxation and windows in regions that have not changed
+#ifndef GECKO_WITH_ACTIVE_SET
+  #define GECKO_WITH_ACTIVE_SET 0
+#endif
+
 // use double-precision computations
 #ifndef GECKO_WITH_DOUBLE_PRECISION
   #define GECKO_WITH_DOUBLE_PRECISION 0
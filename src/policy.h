@@ -0,0 +1,144 @@
+#ifndef GECKO_POLICY_H
+#define GECKO_POLICY_H
+
+#include <cmath>
+#include <typeinfo>
+#include "gecko/functional.h"
+#include "options.h"
+
+namespace Gecko {
+
+// Built-in functionals that add unit-weight terms directly rather than via
+// sum().  Since subclasses of the built-in functionals may override sum(),
+// these are used only for functionals of exactly the built-in types.  Only
+// the most commonly used means have such classes; the square mean root,
+// root mean square, and maximum are called through virtual functions.
+class UnitHarmonic : public FunctionalHarmonic {
+public:
+  using FunctionalHarmonic::accumulate;
+  void accumulate(WeightedSum& s, Float l) const
+  {
+    s.value += 1 / l;
+    s.weight += 1;
+  }
+};
+
+class UnitGeometric : public FunctionalGeometric {
+public:
+  using FunctionalGeometric::accumulate;
+  void accumulate(WeightedSum& s, Float l) const
+  {
+    s.value += std::log(l);
+    s.weight += 1;
+  }
+};
+
+class UnitArithmetic : public FunctionalArithmetic {
+public:
+  using FunctionalArithmetic::accumulate;
+  void accumulate(WeightedSum& s, Float l) const
+  {
+    s.value += l;
+    s.weight += 1;
+  }
+};
+
+#if GECKO_LENGTH_TABLE
+// Logarithms of the integer and half-integer edge lengths up to
+// GECKO_LENGTH_TABLE, which arise from nodes of integer length.  Other
+// lengths are evaluated directly.  Table entries are computed by the same
+// function and hence give identical results.
+class LogTable {
+public:
+  LogTable()
+  {
+    for (uint k = 0; k <= 2 * GECKO_LENGTH_TABLE; k++)
+      value[k] = std::log(Float(k) / 2);
+  }
+  Float operator()(Float l) const
+  {
+    Float h = 2 * l;
+    if (Float(0) <= h && h <= Float(2 * GECKO_LENGTH_TABLE)) {
+      uint k = uint(h);
+      if (Float(k) == h)
+        return value[k];
+    }
+    return std::log(l);
+  }
+  static const LogTable table;
+private:
+  Float value[2 * GECKO_LENGTH_TABLE + 1];
+};
+
+// Geometric mean functional with tabulated logarithms, for graphs whose
+// nodes all have integer length.
+class TabulatedGeometric : public UnitGeometric {
+public:
+  using UnitGeometric::sum;
+  using UnitGeometric::accumulate;
+  WeightedSum sum(const WeightedValue& term) const
+  {
+    return WeightedSum(term.weight * LogTable::table(term.value), term.weight);
+  }
+  void accumulate(WeightedSum& s, Float l) const
+  {
+    s.value += LogTable::table(l);
+    s.weight += 1;
+  }
+};
+#endif
+
+// Calls to a functional of exact type F.  The policy holds its own copy of
+// the (stateless) functional, one of the classes above, whose dynamic type is thus known,
+// such that the compiler may resolve and inline its calls.
+template <class F>
+class Policy {
+public:
+  Policy(const Functional*) {}
+  const F* operator->() const { return &f; }
+private:
+  F f;
+};
+
+// Calls to any functional, e.g., user-defined ones, through its virtual
+// functions.
+template <>
+class Policy<Functional> {
+public:
+  Policy(const Functional* f) : f(f) {}
+  const Functional* operator->() const { return f; }
+private:
+  const Functional* f;
+};
+
+// Functionals with policies of their own, in order.
+enum {
+  policy_virtual,    // Functional
+  policy_harmonic,   // UnitHarmonic
+  policy_geometric,  // UnitGeometric
+  policy_arithmetic, // UnitArithmetic
+#if GECKO_LENGTH_TABLE
+  policy_tabulated,  // TabulatedGeometric
+#endif
+  policies
+};
+
+// Policy for functional f.  Only exact built-in types are recognized, since
+// subclasses may override their terms.  The geometric mean is tabulated
+// per level (see Graph::optimize()).
+inline uint
+policy(const Functional* f)
+{
+  const std::type_info& t = typeid(*f);
+  if (t == typeid(FunctionalHarmonic))
+    return policy_harmonic;
+  if (t == typeid(FunctionalGeometric))
+    return policy_geometric;
+  if (t == typeid(FunctionalArithmetic))
+    return policy_arithmetic;
+  return policy_virtual;
+}
+
+}
+
+#endif
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cmath>
+#include <typeinfo>
+#include "simd.h"
+
+// compile AVX2 variants of the kernels on x86 with GCC and compatible compilers
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define GECKO_SIMD_AVX2 1
+#else
+  #define GECKO_SIMD_AVX2 0
+#endif
+
+using namespace Gecko;
+
+// Terms of built-in functionals, which must match Functional::sum().
+struct TermHarmonic {
+  static Float value(Float w, Float l) { return w / l; }
+};
+
+struct TermSMR {
+  static Float value(Float w, Float l) { return w * std::sqrt(l); }
+};
+
+struct TermArithmetic {
+  static Float value(Float w, Float l) { return w * l; }
+};
+
+struct TermRMS {
+  static Float value(Float w, Float l) { return w * l * l; }
+};
+
+// Bit of each node in an adjacency mask, which spares the compiler from
+// vectorizing variable shifts.
+static const uint bit[] = {
+  0x0001u, 0x0002u, 0x0004u, 0x0008u, 0x0010u, 0x0020u, 0x0040u, 0x0080u,
+  0x0100u, 0x0200u, 0x0400u, 0x0800u, 0x1000u, 0x2000u, 0x4000u, 0x8000u,
+  0x00010000u, 0x00020000u, 0x00040000u, 0x00080000u,
+  0x00100000u, 0x00200000u, 0x00400000u, 0x00800000u,
+  0x01000000u, 0x02000000u, 0x04000000u, 0x08000000u,
+  0x10000000u, 0x20000000u, 0x40000000u, 0x80000000u,
+};
+
+// Accumulate masked sum of terms.  The terms of all GECKO_WINDOW_MAX nodes
+// are evaluated by a branch-free loop of fixed trip count, which compilers
+// vectorize, and are then summed in node order, such that the result does
+// not depend on the vector width.  Rather than selecting terms, which
+// compilers turn back into branches, each term is multiplied by a 0/1 mask
+// and masked lengths are replaced with one to keep all terms finite.
+template <class Term>
+static inline void
+accumulate(WeightedSum& s, const Float* x, const Float* w, Float p, uint m)
+{
+  Float v[GECKO_WINDOW_MAX];
+  Float u[GECKO_WINDOW_MAX];
+  for (uint j = 0; j < GECKO_WINDOW_MAX; j++) {
+    Float l = x[j] - p;
+    Float b = Float(((m & bit[j]) != 0) & (l > 0));
+    l = b * l + (1 - b);
+    v[j] = b * Term::value(w[j], l);
+    u[j] = b * w[j];
+  }
+  for (uint j = 0; m >> j; j++) {
+    s.value += v[j];
+    s.weight += u[j];
+  }
+}
+
+// Accumulate masked maximum length.
+static inline void
+maximum(WeightedSum& s, const Float* x, const Float*, Float p, uint m)
+{
+  Float v[GECKO_WINDOW_MAX];
+  for (uint j = 0; j < GECKO_WINDOW_MAX; j++) {
+    Float l = x[j] - p;
+    Float b = Float(((m & bit[j]) != 0) & (l > 0));
+    v[j] = b * l;
+  }
+  for (uint j = 0; m >> j; j++)
+    s.value = std::max(s.value, v[j]);
+}
+
+// Kernels for the baseline instruction set.
+template <class Term>
+static void
+accumulate_base(WeightedSum& s, const Float* x, const Float* w, Float p, uint m)
+{
+  accumulate<Term>(s, x, w, p, m);
+}
+
+static void
+maximum_base(WeightedSum& s, const Float* x, const Float* w, Float p, uint m)
+{
+  maximum(s, x, w, p, m);
+}
+
+#if GECKO_SIMD_AVX2
+// Kernels for CPUs with AVX2.
+template <class Term>
+__attribute__((target("avx2")))
+static void
+accumulate_avx2(WeightedSum& s, const Float* x, const Float* w, Float p, uint m)
+{
+  accumulate<Term>(s, x, w, p, m);
+}
+
+__attribute__((target("avx2")))
+static void
+maximum_avx2(WeightedSum& s, const Float* x, const Float* w, Float p, uint m)
+{
+  maximum(s, x, w, p, m);
+}
+#endif
+
+// Does the CPU support AVX2?
+static bool
+avx2()
+{
+#if GECKO_SIMD_AVX2
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+// Kernel for given term and instruction set.
+template <class Term>
+static SimdKernel
+kernel()
+{
+#if GECKO_SIMD_AVX2
+  if (avx2())
+    return accumulate_avx2<Term>;
+#endif
+  return accumulate_base<Term>;
+}
+
+SimdKernel
+Gecko::simd_kernel(const Functional* f)
+{
+  // Only exact built-in types are recognized, since subclasses may
+  // override their terms.  Logarithms of the geometric mean have no
+  // vector counterpart in the C++ library and are left to the caller.
+  const std::type_info& t = typeid(*f);
+  if (t == typeid(FunctionalHarmonic))
+    return kernel<TermHarmonic>();
+  if (t == typeid(FunctionalSMR))
+    return kernel<TermSMR>();
+  if (t == typeid(FunctionalArithmetic))
+    return kernel<TermArithmetic>();
+  if (t == typeid(FunctionalRMS))
+    return kernel<TermRMS>();
+  if (t == typeid(FunctionalMaximum)) {
+#if GECKO_SIMD_AVX2
+    if (avx2())
+      return maximum_avx2;
+#endif
+    return maximum_base;
+  }
+  return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef GECKO_SIMD_H
+#define GECKO_SIMD_H
+
+#include "gecko/functional.h"
+#include "options.h"
+
+namespace Gecko {
+
+// Kernel that adds to s the terms with lengths l = x[j] - p > 0 and weights
+// w[j] for all j in the bit set m, where j < GECKO_WINDOW_MAX.  Entries not
+// in m must be finite but are otherwise ignored.
+typedef void (*SimdKernel)(WeightedSum& s, const Float* x, const Float* w, Float p, uint m);
+
+// Vectorized kernel for functional f, selected according to the features
+// of the CPU at hand, or null if f's terms have no vector counterpart.
+SimdKernel simd_kernel(const Functional* f);
+
+}
+
+#endif
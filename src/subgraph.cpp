@@ -1,20 +1,99 @@
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
-#include <stdexcept>
+#include <typeinfo>
+#include "arena.h"
 #include "subgraph.h"
 
 using namespace Gecko;
 
-// Constructor.
-Subgraph::Subgraph(Graph* g, uint n) : g(g), n(n), f(g->functional)
+template <typename I, uint N, class F>
+const uint Subgraph<I, N, F>::n;
+
+// Constructor of subgraph for use by thread t.
+template <typename I, uint N, class F>
+Subgraph<I, N, F>::Subgraph(Graph* g, uint t) :
+  g(g),
+  f(g->functional),
+  unit(g->unit_weights()),
+  external(g->arena->external[t]),
+  frozen(0),
+  rank(0),
+  lo(0),
+  hi(0)
+{
+  // Precomputed nodes of this and the previous window live in the arena,
+  // which retains them across calls.
+  std::vector<Subnode>& buffer = g->arena->cache[t];
+  if (buffer.size() < (size_t(2 * n) << n))
+    buffer.resize(size_t(2 * n) << n);
+  cache = &buffer[0];
+  prior = &buffer[size_t(n) << n];
+  // Nodes are marked with their slots only while in the window.
+  std::vector<Subnode::Index>& marks = g->arena->slot[t];
+  if (marks.size() <= g->nodes())
+    marks.resize(g->nodes() + 1, 0);
+  slot = &marks[0];
+  last = 0;
+  cached = false;
+#if GECKO_WITH_SUBSET_DP
+  linear = typeid(*g->functional) == typeid(FunctionalArithmetic);
+  subset = 0;
+  if (linear) {
+    std::vector<Subset>& table = g->arena->subset[t];
+    if (table.size() < (size_t(1) << n))
+      table.resize(size_t(1) << n);
+    subset = &table[0];
+  }
+#endif
+#if GECKO_WITH_SIMD && !GECKO_WITH_ADJLIST
+  kernel = simd_kernel(g->functional);
+  std::fill(x, x + GECKO_WINDOW_MAX, Float(0));
+#endif
+}
+
+// Read positions of nodes whose ranks were outside {lo, ..., hi - 1}
+// from given array rather than from the graph, which other threads may
+// be modifying.
+template <typename I, uint N, class F>
+void
+Subgraph<I, N, F>::freeze(const Float* pos, const I* rank, I lo, I hi)
+{
+  frozen = pos;
+  this->rank = rank;
+  this->lo = lo;
+  this->hi = hi;
+  cached = false;
+}
+
+// Position of node i.
+template <typename I, uint N, class F>
+Float
+Subgraph<I, N, F>::position(typename Node::Index i) const
+{
+  return frozen && !(lo <= rank[i] && rank[i] < hi) ? frozen[i] : g->pos[i];
+}
+
+// Cost of external arcs of node placed at p.
+template <typename I, uint N, class F>
+WeightedSum
+Subgraph<I, N, F>::external_cost(Float p) const
 {
-  if (n > GECKO_WINDOW_MAX)
-    throw std::out_of_range("optimization window too large");
-  cache = new Subnode[n << n];
+  WeightedSum c;
+  for (std::vector<WeightedValue>::const_iterator v = external.begin(); v != external.end(); v++) {
+    Float l = std::fabs(v->value - p);
+    if (unit)
+      f->accumulate(c, l);
+    else
+      f->accumulate(c, WeightedValue(l, v->weight));
+  }
+  return c;
 }
 
 // Cost of k'th node's edges to external nodes and nodes at {k+1, ..., n-1}.
+template <typename I, uint N, class F>
 WeightedSum
-Subgraph::cost(uint k) const
+Subgraph<I, N, F>::cost(uint k) const
 {
   Subnode::Index i = perm[k];
   WeightedSum c = node[i]->cost;
@@ -24,18 +103,28 @@ Subgraph::cost(uint k) const
     Subnode::Index j = adj[i][k];
     Float l = node[j]->pos - p;
     if (l > 0) {
-      Float w = weight[i][k];
-      f->accumulate(c, WeightedValue(l, w));
+      if (unit)
+        f->accumulate(c, l);
+      else
+        f->accumulate(c, WeightedValue(l, weight[i][k]));
     }
   }
 #else
+#if GECKO_WITH_SIMD
+  if (kernel) {
+    kernel(c, x, weight[i], p, adj[i]);
+    return c;
+  }
+#endif
   uint m = adj[i];
   while (++k < n) {
     Subnode::Index j = perm[k];
     if (m & (1u << j)) {
       Float l = node[j]->pos - p;
-      Float w = weight[i][j];
-      f->accumulate(c, WeightedValue(l, w));
+      if (unit)
+        f->accumulate(c, l);
+      else
+        f->accumulate(c, WeightedValue(l, weight[i][j]));
     }
   }
 #endif
@@ -43,8 +132,9 @@ Subgraph::cost(uint k) const
 }
 
 // Swap the two nodes in positions k and k + 1.
+template <typename I, uint N, class F>
 void
-Subgraph::swap(uint k)
+Subgraph<I, N, F>::swap(uint k)
 {
   uint l = k + 1;
   Subnode::Index i = perm[k];
@@ -53,11 +143,16 @@ Subgraph::swap(uint k)
   perm[l] = i;
   node[i] -= ptrdiff_t(1) << j;
   node[j] += ptrdiff_t(1) << i;
+#if GECKO_WITH_SIMD && !GECKO_WITH_ADJLIST
+  x[i] = node[i]->pos;
+  x[j] = node[j]->pos;
+#endif
 }
 
 // Swap the two nodes in positions k and l, k <= l.
+template <typename I, uint N, class F>
 void
-Subgraph::swap(uint k, uint l)
+Subgraph<I, N, F>::swap(uint k, uint l)
 {
   Subnode::Index i = perm[k];
   Subnode::Index j = perm[l];
@@ -70,18 +165,26 @@ Subgraph::swap(uint k, uint l)
     node[h] += ptrdiff_t(1) << i;
     node[h] -= ptrdiff_t(1) << j;
     m += 1u << h;
+#if GECKO_WITH_SIMD && !GECKO_WITH_ADJLIST
+    x[h] = node[h]->pos;
+#endif
   }
   node[i] -= (1u << j) + m;
   node[j] += (1u << i) + m;
+#if GECKO_WITH_SIMD && !GECKO_WITH_ADJLIST
+  x[i] = node[i]->pos;
+  x[j] = node[j]->pos;
+#endif
 }
 
 #if GECKO_WITH_NONRECURSIVE
 // Evaluate all permutations generated by Heap's nonrecursive algorithm.
+template <typename I, uint N, class F>
 void
-Subgraph::optimize(WeightedSum, uint)
+Subgraph<I, N, F>::optimize(WeightedSum, uint)
 {
-  WeightedSum c[GECKO_WINDOW_MAX + 1];
-  uint j[GECKO_WINDOW_MAX + 1];
+  WeightedSum c[N + 1];
+  uint j[N + 1];
   j[n] = 1;
   c[n] = 0;
   uint i = n;
@@ -104,43 +207,151 @@ loop:
   goto loop;
 }
 #else
-// Apply branch-and-bound to permutations generated by Heap's algorithm.
+// Apply branch-and-bound to permutations generated by Heap's algorithm,
+// permuting the first K nodes.
+template <typename I, uint N, class F>
+template <uint K>
 void
-Subgraph::optimize(WeightedSum c, uint i)
+Subgraph<I, N, F>::optimize(WeightedSum c, Depth<K>)
 {
-  i--;
+  const uint i = K - 1;
   if (f->less(c, min)) {
-    if (i) {
-      uint j = i;
-      do {
-        optimize(f->sum(c, cost(i)), i);
-        swap(i & 1 ? i - j : 0, i);
-      } while (j--);
-    }
-    else {
-      f->accumulate(c, cost(0));
-      if (f->less(c, min)) {
-        min = c;
-        for (uint j = 0; j < n; j++)
-          best[j] = perm[j];
-      }
-    }
+    uint j = i;
+    do {
+      optimize(f->sum(c, cost(i)), Depth<K - 1>());
+      swap(i & 1 ? i - j : 0, i);
+    } while (j--);
   }
   else if (i & 1)
-    do swap(--i); while (i);
+    for (uint k = i; k; k--)
+      swap(k - 1);
+}
+
+// Complete the permutation with the first node.
+template <typename I, uint N, class F>
+void
+Subgraph<I, N, F>::optimize(WeightedSum c, Depth<1>)
+{
+  if (f->less(c, min)) {
+    f->accumulate(c, cost(0));
+    if (f->less(c, min)) {
+      min = c;
+      for (uint j = 0; j < n; j++)
+        best[j] = perm[j];
+    }
+  }
 }
 #endif
 
-// Optimize layout of nodes {p, ..., p + n - 1}.
+#if GECKO_WITH_SUBSET_DP
+// Find optimal permutation by dynamic programming over the subsets of nodes
+// placed first, in O(2^n n^2) time.  Each node's position and external cost
+// depend only on the set of nodes that precede it.  When terms are linear
+// in edge length, so does its share
+//   x_k (w(pred, k) - w(k, succ))
+// of the internal cost sum w_ij (x_j - x_i) over arcs (i, j) with i placed
+// before j, where positions x are taken relative to q to limit roundoff.
+template <typename I, uint N, class F>
 void
-Subgraph::optimize(uint p)
+Subgraph<I, N, F>::optimize_subsets(Float q)
 {
+  // Gather internal arcs (i, j) as bit sets and weights w[i][j].
+  uint out[N];
+  uint in[N];
+  Float w[N][N];
+  for (Subnode::Index k = 0; k < n; k++)
+    in[k] = 0;
+  for (Subnode::Index k = 0; k < n; k++) {
+#if GECKO_WITH_ADJLIST
+    out[k] = 0;
+    for (uint a = 0; adj[k][a] != k; a++) {
+      Subnode::Index j = adj[k][a];
+      out[k] += 1u << j;
+      w[k][j] = unit ? Float(1) : weight[k][a];
+    }
+#else
+    out[k] = adj[k];
+    for (Subnode::Index j = 0; j < n; j++)
+      if (out[k] & (1u << j))
+        w[k][j] = unit ? Float(1) : weight[k][j];
+#endif
+    for (Subnode::Index j = 0; j < n; j++)
+      if (out[k] & (1u << j))
+        in[j] += 1u << k;
+  }
+
+  const uint all = (1u << n) - 1;
+  subset[0].cost = WeightedSum();
+  for (uint m = 1; m <= all; m++) {
+    Subset& s = subset[m];
+    s.cost = WeightedSum(GECKO_FLOAT_MAX, 0);
+    for (Subnode::Index k = 0; k < n; k++)
+      if (m & (1u << k)) {
+        // Place node k after the nodes in m - {k}.
+        uint pred = in[k] & (m - (1u << k));
+        uint succ = out[k] & ~m;
+        const Subnode* t = cache + (k << n) + (all - m);
+        WeightedSum c = subset[m - (1u << k)].cost;
+        f->accumulate(c, t->cost);
+        Float wp = 0;
+        Float ws = 0;
+        for (Subnode::Index j = 0; j < n; j++) {
+          if (pred & (1u << j))
+            wp += w[j][k];
+          if (succ & (1u << j))
+            ws += w[k][j];
+        }
+        c.value += (t->pos - q) * (wp - ws);
+        c.weight += wp;
+        if (f->less(c, s.cost)) {
+          s.cost = c;
+          s.last = k;
+        }
+      }
+  }
+
+  // Recover permutation from last node of each optimal subset.
+  for (uint m = all, k = n; k--; m -= 1u << best[k])
+    best[k] = subset[m].last;
+}
+#endif
+
+// Optimize layout of nodes {p, ..., p + n - 1} and report whether it changed.
+template <typename I, uint N, class F>
+bool
+Subgraph<I, N, F>::optimize(I p)
+{
+  // When sliding forward by one position, this window shares its first
+  // n - 1 nodes with the previous window.  The precomputed positions and
+  // costs of a shared node with the new node succeeding it carry over,
+  // provided that the node is adjacent to neither the new node nor the
+  // node that left, and hence has the same external neighbors.
+  const bool slide = cached && p == last + 1;
+  const typename Node::Index left = slide ? g->perm[p - 1] : typename Node::Index(Node::null);
+  if (slide) {
+    std::swap(cache, prior);
+    // Tabulate, one byte at a time, how subsets of the shared nodes map
+    // to subsets of the previous window.
+    for (uint b = 0; 8 * b < n - 1; b++) {
+      remap[b][0] = 0;
+      for (uint j = 0; j < 8 && 8 * b + j < n - 1; j++)
+        for (uint h = 0; h < (1u << j); h++)
+          remap[b][h + (1u << j)] = remap[b][h] + (1u << order[8 * b + j + 1]);
+    }
+  }
+
   // Initialize subgraph.
-  const Float q = g->node[g->perm[p]].pos - g->node[g->perm[p]].hlen;
+  const Float q = g->pos[g->perm[p]] - g->hlen[g->perm[p]];
+  Float len[N];
+  for (Subnode::Index k = 0; k < n; k++) {
+    len[k] = 2 * g->hlen[g->perm[p + k]];
+    slot[g->perm[p + k]] = Subnode::Index(k + 1);
+  }
   min = WeightedSum(GECKO_FLOAT_MAX, 1);
   for (Subnode::Index k = 0; k < n; k++) {
     best[k] = perm[k] = k;
-    Node::Index i = g->perm[p + k];
+    typename Node::Index i = g->perm[p + k];
+    bool reuse = slide && k != n - 1;
     // Copy i's outgoing arcs.  We distinguish between internal
     // and external arcs to nodes within and outside the subgraph,
     // respectively.
@@ -148,23 +359,38 @@ Subgraph::optimize(uint p)
     uint m = 0;
 #else
     adj[k] = 0;
+#if GECKO_WITH_SIMD
+    // Kernels read weights of all nodes, which must be finite.
+    std::fill(weight[k], weight[k] + GECKO_WINDOW_MAX, Float(0));
 #endif
-    std::vector<Arc::Index> external;
-    for (Arc::Index a = g->node_begin(i); a < g->node_end(i); a++) {
-      Node::Index j = g->adj[a];
-      Subnode::Index l;
-      for (l = 0; l < n && g->perm[p + l] != j; l++);
-      if (l == n)
-        external.push_back(a);
+#endif
+    external.clear();
+    for (typename Arc::Index a = g->node_begin(i); a < g->node_end(i); a++) {
+      typename Node::Index j = g->adj[a];
+      Subnode::Index l = Subnode::Index(slot[j] - 1);
+      if (!slot[j]) {
+        external.push_back(WeightedValue(position(j), g->arc_weight(a)));
+        if (j == left)
+          reuse = false;
+      }
       else {
+        if (l == n - 1)
+          reuse = false;
         // Copy internal arc to subgraph.
 #if GECKO_WITH_ADJLIST
         adj[k][m] = l;
-        weight[k][m] = g->weight[a];
+        if (!unit)
+          weight[k][m] = g->arc_weight(a);
         m++;
 #else
         adj[k] += 1u << l;
-        weight[k][l] = g->weight[a];
+#if GECKO_WITH_SIMD
+        // Kernels use explicit unit weights.
+        weight[k][l] = g->arc_weight(a);
+#else
+        if (!unit)
+          weight[k][l] = g->arc_weight(a);
+#endif
 #endif
       }
     }
@@ -184,29 +410,143 @@ Subgraph::optimize(uint p)
     //   n! sum 1/k! = sum k! C(n, k) = A007526
     //      k=0        k=1
     // costs associated with all permutations.
+    // Positions are computed in order of decreasing successor sets m, as
+    // the position for m plus the length of the last predecessor, which
+    // adds node lengths in the same order as summing over all predecessors.
     node[k] = cache + (k << n);
-    for (uint m = 0; m < (1u << n); m++)
-      if (!(m & (1u << k))) {
-        Subnode* s = cache + (k << n) + m;
-        s->pos = q + g->node[i].hlen;
-        for (Subnode::Index l = 0; l < n; l++)
-          if (l != k && !(m & (1u << l)))
-            s->pos += 2 * g->node[g->perm[p + l]].hlen;
-        s->cost = g->cost(external, s->pos);
+    const uint rest = ((1u << n) - 1) - (1u << k);
+    for (uint m = rest;; m = (m - 1) & rest) {
+      Subnode* s = cache + (k << n) + m;
+      if (m == rest)
+        s->pos = q + g->hlen[i];
+      else {
+        uint l = n - 1;
+        while ((m | (1u << k)) & (1u << l))
+          l--;
+        s->pos = s[1u << l].pos + len[l];
       }
-      else
-        m += (1u << k) - 1;
+      // Reuse cost of previous window if the new node succeeds this one,
+      // but only if roundoff has not perturbed the position.
+      const Subnode* t = 0;
+      if (reuse && (m >> (n - 1))) {
+        uint r = 0;
+        for (uint b = 0; 8 * b < n - 1; b++)
+          r += remap[b][((m - (1u << (n - 1))) >> (8 * b)) & 0xffu];
+        t = prior + (size_t(order[k + 1]) << n) + r;
+      }
+      s->cost = t && t->pos == s->pos ? t->cost : external_cost(s->pos);
+      if (!m)
+        break;
+    }
     node[k] += (1u << n) - (2u << k);
+#if GECKO_WITH_SIMD && !GECKO_WITH_ADJLIST
+    x[k] = node[k]->pos;
+#endif
   }
 
   // Find optimal permutation of the n nodes.
+#if GECKO_WITH_SUBSET_DP
+  if (linear)
+    optimize_subsets(q);
+  else
+#endif
+#if GECKO_WITH_NONRECURSIVE
   optimize(0, n);
+#else
+  optimize(0, Depth<N>());
+#endif
+
+  // Remember optimized order for the next window.
+  for (uint k = 0; k < n; k++)
+    order[k] = best[k];
+  last = p;
+  cached = true;
 
   // Apply permutation to original graph.
+  bool changed = false;
   for (uint i = 0; i < n; i++) {
+    changed |= best[i] != i;
     g->swap(p + i, p + best[i]);
     for (uint j = i + 1; j < n; j++)
       if (best[j] == i)
         best[j] = best[i];
   }
+
+  // Unmark window nodes.
+  for (Subnode::Index k = 0; k < n; k++)
+    slot[g->perm[p + k]] = 0;
+
+  return changed;
+}
+
+// Explicit instantiations for each window size and functional policy.
+#define GECKO_SUBGRAPH_POLICY(N, F) \
+  template class Subgraph<uint16_t, N, F>; \
+  template class Subgraph<uint32_t, N, F>; \
+  template class Subgraph<uint64_t, N, F>;
+
+#define GECKO_SUBGRAPH(N) \
+  GECKO_SUBGRAPH_POLICY(N, Functional) \
+  GECKO_SUBGRAPH_POLICY(N, UnitHarmonic) \
+  GECKO_SUBGRAPH_POLICY(N, UnitGeometric) \
+  GECKO_SUBGRAPH_POLICY(N, UnitArithmetic) \
+  GECKO_SUBGRAPH_TABULATED(N)
+
+#if GECKO_LENGTH_TABLE
+  #define GECKO_SUBGRAPH_TABULATED(N) GECKO_SUBGRAPH_POLICY(N, TabulatedGeometric)
+#else
+  #define GECKO_SUBGRAPH_TABULATED(N)
+#endif
+
+namespace Gecko {
+#if GECKO_LENGTH_TABLE
+const LogTable LogTable::table;
+#endif
+
+GECKO_SUBGRAPH(1)
+#if GECKO_WINDOW_MAX >= 2
+GECKO_SUBGRAPH(2)
+#endif
+#if GECKO_WINDOW_MAX >= 3
+GECKO_SUBGRAPH(3)
+#endif
+#if GECKO_WINDOW_MAX >= 4
+GECKO_SUBGRAPH(4)
+#endif
+#if GECKO_WINDOW_MAX >= 5
+GECKO_SUBGRAPH(5)
+#endif
+#if GECKO_WINDOW_MAX >= 6
+GECKO_SUBGRAPH(6)
+#endif
+#if GECKO_WINDOW_MAX >= 7
+GECKO_SUBGRAPH(7)
+#endif
+#if GECKO_WINDOW_MAX >= 8
+GECKO_SUBGRAPH(8)
+#endif
+#if GECKO_WINDOW_MAX >= 9
+GECKO_SUBGRAPH(9)
+#endif
+#if GECKO_WINDOW_MAX >= 10
+GECKO_SUBGRAPH(10)
+#endif
+#if GECKO_WINDOW_MAX >= 11
+GECKO_SUBGRAPH(11)
+#endif
+#if GECKO_WINDOW_MAX >= 12
+GECKO_SUBGRAPH(12)
+#endif
+#if GECKO_WINDOW_MAX >= 13
+GECKO_SUBGRAPH(13)
+#endif
+#if GECKO_WINDOW_MAX >= 14
+GECKO_SUBGRAPH(14)
+#endif
+#if GECKO_WINDOW_MAX >= 15
+GECKO_SUBGRAPH(15)
+#endif
+#if GECKO_WINDOW_MAX >= 16
+GECKO_SUBGRAPH(16)
+#endif
 }
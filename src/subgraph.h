@@ -3,6 +3,15 @@
 
 #include "gecko/graph.h"
 #include "options.h"
+#include "policy.h"
+#if GECKO_WITH_SIMD
+  #include "simd.h"
+#endif
+
+// subgraphs are specialized for each window size up to 16
+#if GECKO_WINDOW_MAX > 16
+  #error "GECKO_WINDOW_MAX must not exceed 16"
+#endif
 
 namespace Gecko {
 
@@ -14,31 +23,78 @@ public:
   WeightedSum cost; // external cost at this position
 };
 
+// Optimal arrangement of a subset of subgraph nodes placed first.
+class Subset {
+public:
+  WeightedSum cost;    // cost of arrangement
+  Subnode::Index last; // last node in arrangement
+};
+
+// Subgraph of N consecutive nodes ordered by functional of type F.  The
+// window size is a compile-time constant, such that arrays are sized
+// exactly and loops over the nodes have constant trip counts, and calls to
+// built-in functionals are resolved statically (see Policy).
+template <typename I, uint N, class F>
 class Subgraph {
 public:
-  Subgraph(Graph* g, uint n);
-  ~Subgraph() { delete[] cache; }
-  void optimize(uint k);
+  typedef BasicGraph<I> Graph;
+  Subgraph(Graph* g, uint t = 0);
+  void freeze(const Float* pos, const I* rank, I lo, I hi);
+  bool optimize(I k);
 
 private:
+  typedef typename Graph::Arc Arc;
+  typedef typename Graph::Node Node;
+  static const uint n = N;               // number of subgraph nodes
   Graph* const g;                        // full graph
-  const uint n;                          // number of subgraph nodes
-  Functional* const f;                   // ordering functional
+  const Policy<F> f;                     // ordering functional
+  const bool unit;                       // all arcs have unit weight?
   WeightedSum min;                       // minimum cost so far
-  Subnode::Index best[GECKO_WINDOW_MAX]; // best permutation so far
-  Subnode::Index perm[GECKO_WINDOW_MAX]; // current permutation
-  const Subnode* node[GECKO_WINDOW_MAX]; // pointers to precomputed nodes
+  Subnode::Index best[N];                // best permutation so far
+  Subnode::Index perm[N];                // current permutation
+  const Subnode* node[N];                // pointers to precomputed nodes
   Subnode* cache;                        // precomputed node positions and costs
+  Subnode* prior;                        // precomputed nodes of previous window
+  Subnode::Index order[N];               // previous window's nodes in optimized order
+  uint remap[(N + 7) / 8][0x100];        // bytes of subsets mapped to previous window
+  I last;                                // start of previous window
+  bool cached;                           // are precomputed nodes of previous window valid?
+  std::vector<WeightedValue>& external;  // positions and weights of external neighbors
+  Subnode::Index* slot;                  // slot + 1 of window nodes, zero for others
+  const Float* frozen;                   // positions of nodes of other threads
+  const I* rank;                         // ranks of nodes at time of freezing
+  I lo, hi;                              // ranks {lo, ..., hi - 1} not frozen
 #if GECKO_WITH_ADJLIST
-  Subnode::Index adj[GECKO_WINDOW_MAX][GECKO_WINDOW_MAX]; // internal adjacency list
+  Subnode::Index adj[N][N];              // internal adjacency list
 #else
-  uint adj[GECKO_WINDOW_MAX];            // internal adjacency matrix
+  uint adj[N];                           // internal adjacency matrix
+#endif
+#if GECKO_WITH_SIMD && !GECKO_WITH_ADJLIST
+  Float weight[N][GECKO_WINDOW_MAX];     // internal arc weights, padded for kernels
+  SimdKernel kernel;                     // vectorized cost kernel, if any
+  Float x[GECKO_WINDOW_MAX];             // current node positions
+#else
+  Float weight[N][N];                    // internal arc weights
+#endif
+#if GECKO_WITH_SUBSET_DP
+  bool linear;                           // are terms linear in edge length?
+  Subset* subset;                        // optimal arrangements of subsets
+  void optimize_subsets(Float q);
 #endif
-  Float weight[GECKO_WINDOW_MAX][GECKO_WINDOW_MAX]; // internal arc weights
   WeightedSum cost(uint k) const;
+  WeightedSum external_cost(Float p) const;
+  Float position(typename Node::Index i) const;
   void swap(uint k);
   void swap(uint k, uint l);
+#if GECKO_WITH_NONRECURSIVE
   void optimize(WeightedSum c, uint i);
+#else
+  // recursion depth as a type, such that each level is compiled separately
+  template <uint K> class Depth {};
+  template <uint K>
+  void optimize(WeightedSum c, Depth<K>);
+  void optimize(WeightedSum c, Depth<1>);
+#endif
 };
 
 }
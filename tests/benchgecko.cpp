@@ -0,0 +1,265 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "gecko.h"
+#include "gecko/builder.h"
+#include "gecko/graph.h"
+
+using namespace Gecko;
+
+// progress callbacks that accumulate processor time spent in each phase
+// and record the work done by each V-cycle
+class PhaseTimer : public Progress {
+public:
+  void enditer(const Graph* graph, Float, Float) const
+  {
+    activity.push_back(graph->activity());
+  }
+  void beginphase(const Graph*, std::string name) const
+  {
+    phase = name;
+    start = std::clock();
+  }
+  void endphase(const Graph*, bool) const
+  {
+    Timing& t = timing[phase];
+    t.calls++;
+    t.seconds += double(std::clock() - start) / CLOCKS_PER_SEC;
+  }
+  void print(std::ostream& out) const
+  {
+    double total = 0;
+    for (std::map<std::string, Timing>::const_iterator p = timing.begin(); p != timing.end(); p++) {
+      out << "  " << std::setw(10) << std::left << p->first << std::right << std::setw(8) << p->second.calls << std::fixed << std::setprecision(3) << std::setw(10) << p->second.seconds << " s" << std::endl;
+      total += p->second.seconds;
+    }
+    out << "  " << std::setw(18) << std::left << "total" << std::right << std::fixed << std::setprecision(3) << std::setw(10) << total << " s" << std::endl;
+    // percentage of node relaxations and windows skipped in each V-cycle
+    Activity prev;
+    for (size_t k = 0; k < activity.size(); k++) {
+      const Activity& a = activity[k];
+      size_t relaxed = a.relaxed - prev.relaxed;
+      size_t unrelaxed = a.unrelaxed - prev.unrelaxed;
+      size_t optimized = a.optimized - prev.optimized;
+      size_t unoptimized = a.unoptimized - prev.unoptimized;
+      out << "  cycle " << std::setw(3) << k + 1 << std::setprecision(1) << " skipped" << std::setw(6) << percent(unrelaxed, relaxed + unrelaxed) << "% nodes" << std::setw(6) << percent(unoptimized, optimized + unoptimized) << "% windows" << std::endl;
+      prev = a;
+    }
+  }
+private:
+  static double percent(size_t part, size_t total) { return total ? 100. * double(part) / double(total) : 0.; }
+
+  struct Timing {
+    Timing() : calls(0), seconds(0) {}
+    uint calls;
+    double seconds;
+  };
+  mutable std::map<std::string, Timing> timing;
+  mutable std::string phase;
+  mutable std::vector<Activity> activity;
+  mutable std::clock_t start;
+};
+
+// construct 3D grid with given stencil radius in the infinity norm
+// (radius 1 yields the 27-point stencil; use star = true for 7 points)
+static void
+grid(Graph& graph, uint size, uint radius = 1, bool star = false)
+{
+  int r = int(radius);
+  int n = int(size);
+  for (int z = 0; z < n; z++)
+    for (int y = 0; y < n; y++)
+      for (int x = 0; x < n; x++) {
+        Node::Index i = graph.insert_node();
+        for (int dz = -r; dz <= r; dz++)
+          for (int dy = -r; dy <= r; dy++)
+            for (int dx = -r; dx <= r; dx++) {
+              if (!dx && !dy && !dz)
+                continue;
+              if (star && std::abs(dx) + std::abs(dy) + std::abs(dz) != 1)
+                continue;
+              if (0 <= x + dx && x + dx < n && 0 <= y + dy && y + dy < n && 0 <= z + dz && z + dz < n)
+                graph.insert_arc(i, Node::Index(1 + x + dx + n * (y + dy + n * (z + dz))));
+            }
+      }
+}
+
+// assemble 3D grid with 27-point stencil from edges in random order and
+// report throughput
+static void
+build(uint size)
+{
+  // enumerate edges {i, j}, i < j, in pseudo-random order
+  std::vector<Node::Index> head;
+  std::vector<Node::Index> tail;
+  int n = int(size);
+  for (int z = 0; z < n; z++)
+    for (int y = 0; y < n; y++)
+      for (int x = 0; x < n; x++)
+        for (int dz = 0; dz <= 1; dz++)
+          for (int dy = -dz; dy <= 1; dy++)
+            for (int dx = -(dy | dz); dx <= 1; dx++)
+              if ((dx || dy || dz) && 0 <= x + dx && x + dx < n && y + dy < n && 0 <= y + dy && z + dz < n) {
+                head.push_back(Node::Index(1 + x + n * (y + n * z)));
+                tail.push_back(Node::Index(1 + x + dx + n * (y + dy + n * (z + dz))));
+              }
+  uint state = 1;
+  for (size_t k = 0; k < head.size(); k++) {
+    state = 0x1ed0675 * state + 0xa14f;
+    size_t l = k + (state >> 8) % (head.size() - k);
+    std::swap(head[k], head[l]);
+    std::swap(tail[k], tail[l]);
+  }
+
+  std::clock_t start = std::clock();
+  GraphBuilder builder;
+  builder.reserve(head.size());
+  for (size_t k = 0; k < head.size(); k++)
+    builder.insert_edge(head[k], tail[k]);
+  Graph graph;
+  builder.build(graph);
+  double seconds = double(std::clock() - start) / CLOCKS_PER_SEC;
+  std::cout << "build27: V=" << graph.nodes() << " E=" << graph.edges() << " t=" << std::fixed << std::setprecision(3) << seconds << " s (" << std::setprecision(1) << 1e-6 * double(head.size()) / seconds << " M edges/s)" << std::endl;
+}
+
+// read graph from file in chaco format
+static bool
+read(Graph& graph, const char* path)
+{
+  FILE* file = std::fopen(path, "r");
+  if (!file)
+    return false;
+  uint nv, ne, fmt = 0;
+  char line[0x10000];
+  bool ok = std::fgets(line, sizeof(line), file) && std::sscanf(line, "%u%u%u", &nv, &ne, &fmt) >= 2;
+  if (fmt != 1)
+    graph.discard_weights();
+  for (Node::Index i = 1; ok && i <= nv; i++) {
+    graph.insert_node();
+    do
+      ok = std::fgets(line, sizeof(line), file) != 0;
+    while (ok && (line[0] == '%' || line[0] == '#'));
+    int n;
+    for (uint k = 0, j; ok && std::sscanf(line + k, "%u%n", &j, &n) == 1; k += n) {
+      double w = 1;
+      if (fmt == 1) {
+        k += n;
+        ok = std::sscanf(line + k, "%lf%n", &w, &n) == 1;
+      }
+      ok = ok && graph.insert_arc(i, j, Float(w), Float(w));
+    }
+  }
+  std::fclose(file);
+  return ok;
+}
+
+// order graph by given functional (geometric mean by default) and report
+// phase timings
+static void
+run(Graph& graph, const std::string& name, uint iterations, uint window, Functional* functional = 0)
+{
+  PhaseTimer timer;
+  if (!functional)
+    functional = new FunctionalGeometric();
+  std::clock_t start = std::clock();
+  graph.order(functional, iterations, window, 1, 1, &timer);
+  double seconds = double(std::clock() - start) / CLOCKS_PER_SEC;
+  std::cout << name << ": V=" << graph.nodes() << " E=" << graph.edges() << " f=" << std::fixed << std::setprecision(6) << graph.cost() << " t=" << std::setprecision(3) << seconds << " s" << std::endl;
+  timer.print(std::cout);
+  delete functional;
+}
+
+int main(int argc, char* argv[])
+{
+  uint size = 16;      // grid dimensions
+  uint iterations = 4; // number of V cycles
+  uint window = 3;     // initial window size
+
+  switch (argc > 4 ? 4 : argc) {
+    case 4:
+      if (std::sscanf(argv[3], "%u", &window) != 1)
+        goto usage;
+      // FALLTHROUGH
+    case 3:
+      if (std::sscanf(argv[2], "%u", &iterations) != 1)
+        goto usage;
+      // FALLTHROUGH
+    case 2:
+      if (std::sscanf(argv[1], "%u", &size) != 1)
+        goto usage;
+      // FALLTHROUGH
+    case 1:
+      break;
+    default:
+    usage:
+      std::cerr << "Usage: benchgecko [size [iterations [window [graph ...]]]]" << std::endl;
+      return EXIT_FAILURE;
+  }
+
+  std::cout << Gecko::version_string << std::endl;
+
+  // graph assembly from unordered edges
+  build(4 * size);
+
+  // 3D grid with 7-point stencil
+  {
+    Graph graph;
+    grid(graph, size, 1, true);
+    run(graph, "grid7", iterations, window);
+  }
+
+  // 3D grid with 7-point stencil and arithmetic mean, whose windows may be
+  // optimized by dynamic programming (see GECKO_WITH_SUBSET_DP)
+  {
+    Graph graph;
+    grid(graph, size, 1, true);
+    run(graph, "grid7a", iterations, window, new FunctionalArithmetic());
+  }
+
+  // 3D grid with 27-point stencil
+  {
+    Graph graph;
+    grid(graph, size, 1);
+    run(graph, "grid27", iterations, window);
+  }
+
+  // 3D grid with 27-point stencil and unit weights
+  {
+    Graph graph;
+    graph.discard_weights();
+    grid(graph, size, 1);
+    run(graph, "grid27u", iterations, window);
+  }
+
+  // 3D grid with 27-point stencil and shared edge weights
+  {
+    Graph graph;
+    grid(graph, size, 1);
+    graph.share_weights();
+    run(graph, "grid27s", iterations, window);
+  }
+
+  // 3D grid with 125-point stencil (high degree)
+  {
+    Graph graph;
+    grid(graph, size / 2, 2);
+    run(graph, "grid125", iterations, window);
+  }
+
+  // user-supplied graphs in chaco format
+  for (int i = 4; i < argc; i++) {
+    Graph graph;
+    if (!read(graph, argv[i])) {
+      std::cerr << "cannot read graph " << argv[i] << std::endl;
+      return EXIT_FAILURE;
+    }
+    run(graph, argv[i], iterations, window);
+  }
+
+  return EXIT_SUCCESS;
+}
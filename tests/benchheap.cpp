@@ -0,0 +1,147 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "gecko/types.h"
+#include "heap.h"
+
+using namespace Gecko;
+
+// 3D grid with 27-point stencil in compressed sparse row format
+struct Grid {
+  Grid(uint size);
+  std::vector<uint> offset; // arcs of node i are {offset[i], ..., offset[i+1]-1}
+  std::vector<uint> adj;    // adjacent nodes
+  std::vector<Float> bond;  // arc weights
+  uint nodes() const { return uint(offset.size() - 1); }
+};
+
+Grid::Grid(uint size)
+{
+  int n = int(size);
+  uint state = 1;
+  offset.push_back(0);
+  for (int z = 0; z < n; z++)
+    for (int y = 0; y < n; y++)
+      for (int x = 0; x < n; x++) {
+        for (int dz = -1; dz <= 1; dz++)
+          for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++)
+              if ((dx || dy || dz) && 0 <= x + dx && x + dx < n && 0 <= y + dy && y + dy < n && 0 <= z + dz && z + dz < n) {
+                adj.push_back(uint(x + dx + n * (y + dy + n * (z + dz))));
+                state = 0x1ed0675 * state + 0xa14f;
+                bond.push_back(Float(1 + (state >> 16) % 8) / 8);
+              }
+        offset.push_back(uint(adj.size()));
+      }
+}
+
+// Select coarse nodes as in Graph::coarsen(): extract node of maximum
+// importance and reduce the importance of its neighbors.
+template <class Queue>
+static double
+coarsen(const Grid& g, Queue& queue)
+{
+  double sum = 0;
+  for (uint i = 0; i < g.nodes(); i++) {
+    Float w = 0;
+    for (uint a = g.offset[i]; a < g.offset[i + 1]; a++)
+      w += g.bond[a];
+    queue.insert(i, w);
+  }
+  while (!queue.empty()) {
+    uint i;
+    Float w;
+    queue.extract(i, w);
+    sum += w;
+    for (uint a = g.offset[i]; a < g.offset[i + 1]; a++) {
+      uint j = g.adj[a];
+      if (queue.find(j, w))
+        queue.update(j, w - 2 * g.bond[a]);
+    }
+  }
+  return sum;
+}
+
+// Order nodes as in Graph::refine(): extract node most strongly connected
+// to extracted nodes and increase the connectivity of its neighbors.
+template <class Queue>
+static double
+refine(const Grid& g, Queue& queue)
+{
+  double sum = 0;
+  for (uint i = 0; i < g.nodes(); i++)
+    queue.insert(i, Float(i % 3 ? 0 : 1));
+  while (!queue.empty()) {
+    uint i;
+    Float w;
+    queue.extract(i, w);
+    sum += w;
+    for (uint a = g.offset[i]; a < g.offset[i + 1]; a++) {
+      uint j = g.adj[a];
+      if (queue.find(j, w))
+        queue.update(j, w + g.bond[a]);
+    }
+  }
+  return sum;
+}
+
+// time given number of runs of both access patterns (or only the refine
+// pattern, whose priorities are nonnegative)
+template <class Queue>
+static void
+run(const Grid& g, const std::string& name, uint runs, bool both = true)
+{
+  Queue queue(g.nodes());
+  double sum = 0;
+  std::clock_t start = std::clock();
+  for (uint k = 0; both && k < runs; k++)
+    sum += coarsen(g, queue);
+  double tc = double(std::clock() - start) / CLOCKS_PER_SEC;
+  start = std::clock();
+  for (uint k = 0; k < runs; k++)
+    sum += refine(g, queue);
+  double tr = double(std::clock() - start) / CLOCKS_PER_SEC;
+  std::cout << "  " << std::setw(12) << std::left << name << std::right << std::fixed << std::setprecision(3);
+  if (both)
+    std::cout << std::setw(8) << tc << " s";
+  else
+    std::cout << std::setw(10) << "-";
+  std::cout << std::setw(8) << tr << " s  (" << std::setprecision(0) << sum << ")" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  uint size = 32; // grid dimensions
+  uint runs = 10; // number of runs per queue
+
+  switch (argc > 3 ? 3 : argc) {
+    case 3:
+      if (std::sscanf(argv[2], "%u", &runs) != 1)
+        goto usage;
+      // FALLTHROUGH
+    case 2:
+      if (std::sscanf(argv[1], "%u", &size) != 1)
+        goto usage;
+      // FALLTHROUGH
+    case 1:
+      break;
+    default:
+    usage:
+      std::cerr << "Usage: benchheap [size [runs]]" << std::endl;
+      return EXIT_FAILURE;
+  }
+
+  Grid g(size);
+  std::cout << "grid27: V=" << g.nodes() << " runs=" << runs << std::endl;
+  std::cout << "  queue         coarsen    refine" << std::endl;
+  run<DynamicHeap<uint, Float, std::less<Float>, uint, MapIndex<uint, uint>, 2> >(g, "map 2-ary", runs);
+  run<DynamicHeap<uint, Float, std::less<Float>, uint, DenseIndex<uint, uint>, 2> >(g, "dense 2-ary", runs);
+  run<DynamicHeap<uint, Float, std::less<Float>, uint, DenseIndex<uint, uint>, 4> >(g, "dense 4-ary", runs);
+  run<BucketQueue<uint, Float> >(g, "bucket", runs, false);
+
+  return EXIT_SUCCESS;
+}
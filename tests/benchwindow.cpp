@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include "gecko.h"
+#include "gecko/graph.h"
+
+using namespace Gecko;
+
+// progress callbacks that accumulate processor time spent optimizing
+// windows of each size
+class WindowTimer : public Progress {
+public:
+  void beginphase(const Graph* graph, std::string name) const
+  {
+    size = 0;
+    if (name.compare(0, 4, "perm") == 0 && std::sscanf(name.c_str() + 4, "%u", &size) == 1 && size) {
+      nodes = graph->nodes();
+      start = std::clock();
+    }
+  }
+  void endphase(const Graph*, bool) const
+  {
+    if (size) {
+      Timing& t = timing[size];
+      t.windows += nodes - size + 1;
+      t.seconds += double(std::clock() - start) / CLOCKS_PER_SEC;
+    }
+  }
+  void print(std::ostream& out) const
+  {
+    out << "  size   windows   us/window" << std::endl;
+    for (std::map<uint, Timing>::const_iterator p = timing.begin(); p != timing.end(); p++)
+      out << "  " << std::setw(4) << p->first << std::setw(10) << p->second.windows << std::fixed << std::setprecision(3) << std::setw(12) << 1e6 * p->second.seconds / double(p->second.windows) << std::endl;
+  }
+private:
+  struct Timing {
+    Timing() : windows(0), seconds(0) {}
+    size_t windows;
+    double seconds;
+  };
+  mutable std::map<uint, Timing> timing;
+  mutable uint size;
+  mutable uint nodes;
+  mutable std::clock_t start;
+};
+
+// construct 3D grid with 7-point stencil
+static void
+grid(Graph& graph, uint size)
+{
+  int n = int(size);
+  for (int z = 0; z < n; z++)
+    for (int y = 0; y < n; y++)
+      for (int x = 0; x < n; x++) {
+        Node::Index i = graph.insert_node();
+        if (x > 0)
+          graph.insert_arc(i, i - 1);
+        if (x < n - 1)
+          graph.insert_arc(i, i + 1);
+        if (y > 0)
+          graph.insert_arc(i, i - n);
+        if (y < n - 1)
+          graph.insert_arc(i, i + n);
+        if (z > 0)
+          graph.insert_arc(i, i - n * n);
+        if (z < n - 1)
+          graph.insert_arc(i, i + n * n);
+      }
+}
+
+// order grid once with each initial window size and report the time per
+// window of each size optimized at any level
+static void
+run(uint size, uint maxwindow, Functional* functional, const std::string& name)
+{
+  WindowTimer timer;
+  for (uint window = 1; window <= maxwindow; window++) {
+    Graph graph;
+    grid(graph, size);
+    graph.order(functional, 1, window, 0, 1, &timer);
+  }
+  std::cout << name << ":" << std::endl;
+  timer.print(std::cout);
+  delete functional;
+}
+
+int main(int argc, char* argv[])
+{
+  uint size = 10;     // grid dimensions
+  uint maxwindow = 7; // max initial window size
+
+  switch (argc) {
+    case 3:
+      if (std::sscanf(argv[2], "%u", &maxwindow) != 1)
+        goto usage;
+      // FALLTHROUGH
+    case 2:
+      if (std::sscanf(argv[1], "%u", &size) != 1)
+        goto usage;
+      // FALLTHROUGH
+    case 1:
+      break;
+    default:
+    usage:
+      std::cerr << "Usage: benchwindow [size [maxwindow]]" << std::endl;
+      return EXIT_FAILURE;
+  }
+
+  std::cout << Gecko::version_string << std::endl;
+  run(size, maxwindow, new FunctionalGeometric(), "geometric");
+  run(size, maxwindow, new FunctionalArithmetic(), "arithmetic");
+
+  return EXIT_SUCCESS;
+}
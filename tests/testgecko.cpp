@@ -1,10 +1,15 @@
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include "gecko.h"
+#include "gecko/builder.h"
 #include "gecko/graph.h"
 
 using namespace Gecko;
@@ -184,6 +189,657 @@ grid_test(
     return stringize(cost) + " > " + stringize(mincost);
 }
 
+// construct 2D grid from compressed sparse row arrays and ensure it orders
+// identically to the same grid constructed one arc at a time
+static std::string
+csr_test(
+  uint size,           // number of nodes along each dimension
+  uint iterations = 3, // number of V cycles
+  uint window = 4,     // initial window size
+  uint period = 1,     // iterations between window increment
+  uint seed = 1        // random number seed
+)
+{
+  uint nodes = size * size; // grid node count
+
+  // construct zero-based compressed sparse row arrays and reference graph
+  std::vector<Arc::Index> offset(1, 0);
+  std::vector<Node::Index> target;
+  std::vector<Float> weight;
+  Graph graph(nodes);
+  for (Node::Index i = 1; i <= nodes; i++) {
+    uint x = (i - 1) % size;
+    uint y = (i - 1) / size;
+    Node::Index neighbor[4];
+    uint n = 0;
+    if (y > 0)
+      neighbor[n++] = i - size;
+    if (x > 0)
+      neighbor[n++] = i - 1;
+    if (x < size - 1)
+      neighbor[n++] = i + 1;
+    if (y < size - 1)
+      neighbor[n++] = i + size;
+    for (uint k = 0; k < n; k++) {
+      Float w = Float(1 + (i + neighbor[k]) % 3);
+      graph.insert_arc(i, neighbor[k], w, w);
+      target.push_back(neighbor[k] - 1);
+      weight.push_back(w);
+    }
+    offset.push_back(Arc::Index(target.size()));
+  }
+
+  // construct graph by copying arrays
+  Graph copy(nodes, &offset[0], &target[0], &weight[0]);
+
+  // construct graph by adopting arrays in native layout
+  for (Arc::Index a = 0; a <= nodes; a++)
+    offset[a]++;
+  for (Arc::Index a = 0; a < target.size(); a++)
+    target[a]++;
+  target.insert(target.begin(), Node::null);
+  weight.insert(weight.begin(), Float(0));
+  Graph adopted;
+  if (!adopted.adopt(offset, target, weight))
+    return std::string("adoption failed");
+  if (!offset.empty() || !target.empty() || !weight.empty())
+    return std::string("adopted arrays not released");
+
+  if (copy.nodes() != graph.nodes() || adopted.nodes() != graph.nodes())
+    return std::string("incorrect node count");
+  if (copy.edges() != graph.edges() || adopted.edges() != graph.edges())
+    return std::string("incorrect edge count");
+
+  // order graphs
+  Functional* functional = new FunctionalGeometric();
+  graph.order(functional, iterations, window, period, seed);
+  copy.order(functional, iterations, window, period, seed);
+  adopted.order(functional, iterations, window, period, seed);
+  delete functional;
+
+  // ensure identical permutations
+  if (copy.permutation() != graph.permutation())
+    return std::string("copied graph ordered differently");
+  if (adopted.permutation() != graph.permutation())
+    return std::string("adopted graph ordered differently");
+
+  // ensure arcs are paired with their reverse arcs
+  for (Node::Index i = 1; i <= nodes; i++)
+    for (Arc::Index a = adopted.node_begin(i); a < adopted.node_end(i); a++) {
+      Arc::Index b = adopted.reverse_arc(a);
+      if (adopted.arc_source(a) != i || adopted.arc_source(b) != adopted.arc_target(a) || adopted.arc_target(b) != i)
+        return std::string("incorrect reverse arc");
+    }
+
+  // ensure invalid arrays are rejected
+  std::vector<Arc::Index> o(2, 1);
+  std::vector<Node::Index> t(1, Node::null);
+  std::vector<Float> w;
+  o[1] = 2;
+  t.push_back(1);
+  if (adopted.adopt(o, t, w))
+    return std::string("self loop accepted");
+
+  // ensure graphs whose one-based indices overflow are rejected
+  std::vector<uint16_t> offset16(std::numeric_limits<uint16_t>::max() + 1, 0);
+  try {
+    Graph16 overflow(std::numeric_limits<uint16_t>::max(), &offset16[0], 0);
+    return std::string("node index overflow accepted");
+  }
+  catch (std::invalid_argument&) {}
+
+  return std::string();
+}
+
+// construct hypercube from shuffled, one-directional, duplicate edges and
+// ensure it is laid out as the same graph constructed arc by arc
+static std::string
+builder_test(
+  uint dims,           // number of hypercube dimensions
+  uint iterations = 4, // number of V cycles
+  uint window = 6,     // initial window size
+  uint period = 1,     // iterations between window increment
+  uint seed = 1        // random number seed
+)
+{
+  uint nodes = 1u << dims;       // hypercube node count
+  uint edges = dims * nodes / 2; // hypercube edge count
+
+  // enumerate each edge {i, j} once in the direction i < j
+  std::vector<std::pair<Node::Index, Node::Index> > edge;
+  for (Node::Index i = 1; i <= nodes; i++)
+    for (uint d = 0; d < dims; d++) {
+      Node::Index j = ((i - 1) ^ (1u << d)) + 1;
+      if (i < j)
+        edge.push_back(std::make_pair(i, j));
+    }
+
+  // insert edges in pseudo-random order and direction with duplicates
+  GraphBuilder builder;
+  uint state = 1;
+  for (uint k = 0; k < edge.size(); k++) {
+    state = 0x1ed0675 * state + 0xa14f;
+    std::swap(edge[k], edge[k + (state >> 8) % (edge.size() - k)]);
+    Node::Index i = edge[k].first;
+    Node::Index j = edge[k].second;
+    if (state & 0x100)
+      std::swap(i, j);
+    builder.insert_edge(i, j);
+    if (state & 0x200)
+      builder.insert_edge(j, i);
+  }
+  if (builder.insert_edge(1, 1) || builder.insert_edge(0, 1))
+    return std::string("invalid edge accepted");
+
+  Graph graph;
+  if (!builder.build(graph))
+    return std::string("graph assembly failed");
+  if (graph.nodes() != nodes)
+    return std::string("incorrect node count");
+  if (graph.edges() != edges)
+    return std::string("incorrect edge count");
+  if (graph.directed())
+    return std::string("graph is directed");
+  for (Node::Index i = 1; i <= nodes; i++)
+    for (Arc::Index a = graph.node_begin(i); a < graph.node_end(i); a++) {
+      Arc::Index b = graph.reverse_arc(a);
+      if (graph.arc_weight(a) != graph.arc_weight(b))
+        return std::string("asymmetric arc weights");
+    }
+
+  // construct same graph with arcs inserted in order of increasing target
+  Graph reference(nodes);
+  for (Node::Index i = 1; i <= nodes; i++)
+    for (Node::Index j = 1; j <= nodes; j++) {
+      uint d = (i - 1) ^ (j - 1);
+      if (d && !(d & (d - 1)))
+        reference.insert_arc(i, j);
+    }
+  for (Arc::Index a = 1; a <= 2 * edges; a++)
+    if (graph.arc_source(a) != reference.arc_source(a) || graph.arc_target(a) != reference.arc_target(a))
+      return std::string("arcs not ordered by source and target");
+
+  // order both graphs and ensure they have the same layout
+  Functional* functional = new FunctionalGeometric();
+  graph.order(functional, iterations, window, period, seed);
+  reference.order(functional, iterations, window, period, seed);
+  delete functional;
+  for (uint rank = 0; rank < nodes; rank++)
+    if (graph.permutation(rank) != reference.permutation(rank))
+      return std::string("layout differs from that of graph constructed arc by arc");
+
+  // ensure duplicate edge weights are merged
+  GraphBuilder sum(3, true);
+  sum.insert_edge(2, 1, 2);
+  sum.insert_edge(1, 2, 3);
+  if (!sum.build(graph) || graph.nodes() != 3 || graph.edges() != 1 || graph.arc_weight(graph.arc_index(2, 1)) != 5)
+    return std::string("duplicate edge weights not summed");
+
+  return std::string();
+}
+
+// predicate for selecting arcs with weight below a threshold
+class WeakArc {
+public:
+  WeakArc(Float threshold) : threshold(threshold) {}
+  bool operator()(Node::Index, Node::Index, Float w) const { return w < threshold; }
+private:
+  Float threshold;
+};
+
+// remove weak edges from 2D grid in a single pass and ensure the result
+// matches removing them one at a time
+static std::string
+removal_test(
+  uint size // number of nodes along each dimension
+)
+{
+  uint nodes = size * size; // grid node count
+
+  // construct two identical grids with some weak edges
+  Graph graph(nodes);
+  Graph reference(nodes);
+  std::vector<std::pair<Node::Index, Node::Index> > weak;
+  for (Node::Index i = 1; i <= nodes; i++) {
+    uint x = (i - 1) % size;
+    uint y = (i - 1) / size;
+    Node::Index neighbor[4];
+    uint n = 0;
+    if (x > 0)
+      neighbor[n++] = i - 1;
+    if (x < size - 1)
+      neighbor[n++] = i + 1;
+    if (y > 0)
+      neighbor[n++] = i - size;
+    if (y < size - 1)
+      neighbor[n++] = i + size;
+    for (uint k = 0; k < n; k++) {
+      Node::Index j = neighbor[k];
+      Float w = (i + j) % 5 ? Float(1) : Float(0.25);
+      graph.insert_arc(i, j, w);
+      reference.insert_arc(i, j, w);
+      if (w < 1 && i < j)
+        weak.push_back(std::make_pair(i, j));
+    }
+  }
+
+  // remove weak edges
+  uint removed = graph.remove_edges(WeakArc(Float(0.5)));
+  if (removed != 2 * weak.size())
+    return std::string("incorrect number of arcs removed");
+  for (uint k = 0; k < weak.size(); k++)
+    reference.remove_edge(weak[k].first, weak[k].second);
+
+  // remove one more edge by arc index
+  std::vector<Arc::Index> arcs(1, graph.arc_index(1, 2));
+  graph.remove_edges(arcs);
+  reference.remove_edge(1, 2);
+
+  // ensure graphs are identical
+  if (graph.edges() != reference.edges() || graph.directed())
+    return std::string("incorrect edge count");
+  for (Node::Index i = 1; i <= nodes; i++) {
+    if (graph.node_begin(i) != reference.node_begin(i) || graph.node_end(i) != reference.node_end(i))
+      return std::string("incorrect node offsets");
+    for (Arc::Index a = graph.node_begin(i); a < graph.node_end(i); a++)
+      if (graph.arc_source(a) != i || graph.arc_target(a) != reference.arc_target(a) || graph.arc_weight(a) != reference.arc_weight(a))
+        return std::string("incorrect arc");
+  }
+
+  // order graph
+  Functional* functional = new FunctionalGeometric();
+  graph.order(functional, 2, 4, 1, 1);
+  delete functional;
+
+  return std::string();
+}
+
+// order 2D grid with shared edge weights and ensure the layout is optimal,
+// then ensure removing edges keeps arcs consistent and that arcs cannot be
+// removed without their reverse arcs
+static std::string
+shared_test(
+  uint size // number of nodes along each dimension
+)
+{
+  // known minimal edge products
+  double minproduct[] = { 0., 1., 3., 225., 688905., 145904338125., 984582541613671875. };
+
+  if (size > sizeof(minproduct) / sizeof(minproduct[0]))
+    return std::string("grid size exceeds maximum size");
+
+  uint nodes = size * size;           // grid node count
+  uint edges = 2 * size * (size - 1); // grid edge count
+
+  Float mincost = edges ? Float(std::exp(std::log(minproduct[size]) / edges)) : Float(0);
+
+  // construct grid and share weights
+  Graph graph(nodes);
+  for (Node::Index i = 1; i <= nodes; i++) {
+    uint x = (i - 1) % size;
+    uint y = (i - 1) / size;
+    if (y > 0)
+      graph.insert_arc(i, i - size);
+    if (x > 0)
+      graph.insert_arc(i, i - 1);
+    if (x < size - 1)
+      graph.insert_arc(i, i + 1);
+    if (y < size - 1)
+      graph.insert_arc(i, i + size);
+  }
+  if (!graph.share_weights() || !graph.shared_weights())
+    return std::string("cannot share weights");
+  if (graph.edges() != edges)
+    return std::string("incorrect edge count");
+
+  // directed graphs cannot share weights
+  Graph directed(2);
+  directed.insert_arc(1, 2);
+  if (directed.share_weights())
+    return std::string("directed graph shares weights");
+
+  // order graph
+  Functional* functional = new FunctionalGeometric();
+  graph.order(functional, 9, 5, 2, 1);
+  Float cost = graph.cost();
+  delete functional;
+  Float epsilon = Float(1e-2);
+  if (cost > Float(1 + epsilon) * mincost)
+    return stringize(cost) + " > " + stringize(mincost);
+
+  // remove an edge and ensure each arc is paired with its reverse
+  graph.remove_edge(1, 2);
+  if (graph.edges() != edges - 1 || graph.directed())
+    return std::string("incorrect edge count after removal");
+  for (Node::Index i = 1; i <= nodes; i++)
+    for (Arc::Index a = graph.node_begin(i); a < graph.node_end(i); a++) {
+      Arc::Index b = graph.reverse_arc(a);
+      if (graph.arc_source(a) != i || graph.arc_source(b) != graph.arc_target(a) || graph.arc_weight(a) != 1)
+        return std::string("incorrect arc");
+    }
+
+  // removing one arc of an edge fails and leaves the graph unmodified
+  Graph path(3);
+  path.insert_arc(1, 2);
+  path.insert_arc(2, 1);
+  path.insert_arc(2, 3);
+  path.insert_arc(3, 2);
+  if (!path.share_weights())
+    return std::string("cannot share path weights");
+  std::vector<Arc::Index> arcs(1, path.arc_index(2, 3));
+  if (path.remove_arc(1, 2) || path.remove_arcs(arcs) || path.edges() != 2)
+    return std::string("arc removed without its reverse arc");
+  for (Node::Index i = 1; i <= 3; i++)
+    for (Arc::Index a = path.node_begin(i); a < path.node_end(i); a++)
+      if (path.arc_source(a) != i)
+        return std::string("incorrect arc source after failed removal");
+  if (!path.remove_edge(1, 2) || path.edges() != 1 || path.arc_source(path.arc_index(3, 2)) != 3)
+    return std::string("cannot remove shared edge");
+
+  return std::string();
+}
+
+// construct 2D grid with given index type
+template <typename I>
+static void
+grid(BasicGraph<I>& graph, uint size)
+{
+  for (I i = 1; i <= size * size; i++) {
+    graph.insert_node();
+    uint x = (i - 1) % size;
+    uint y = (i - 1) / size;
+    if (y > 0)
+      graph.insert_arc(i, I(i - size));
+    if (x > 0)
+      graph.insert_arc(i, I(i - 1));
+    if (x < size - 1)
+      graph.insert_arc(i, I(i + 1));
+    if (y < size - 1)
+      graph.insert_arc(i, I(i + size));
+  }
+}
+
+// order 2D grid using 16-, 32-, and 64-bit indices and ensure the orderings
+// agree, then ensure 16-bit graphs reject nodes that cannot be indexed
+static std::string
+index_test(
+  uint size // number of nodes along each dimension
+)
+{
+  // order grids
+  Graph16 graph16;
+  Graph32 graph32;
+  Graph64 graph64;
+  grid(graph16, size);
+  grid(graph32, size);
+  grid(graph64, size);
+  Functional* functional = new FunctionalGeometric();
+  graph16.order(functional, 3, 4, 1, 1);
+  graph32.order(functional, 3, 4, 1, 1);
+  graph64.order(functional, 3, 4, 1, 1);
+  delete functional;
+  for (uint k = 0; k < size * size; k++)
+    if (graph16.permutation(k) != graph32.permutation(k) || graph64.permutation(k) != graph32.permutation(k))
+      return std::string("orderings differ");
+
+  // exhaust 16-bit node indices
+  Graph16 graph(std::numeric_limits<uint16_t>::max() - 1);
+  if (graph.insert_node() != Graph16::Node::null)
+    return std::string("node index overflow");
+
+  return std::string();
+}
+
+// mean of squared lengths, which derives from a built-in functional and
+// overrides its terms
+class FunctionalSquare : public FunctionalArithmetic {
+public:
+  using FunctionalArithmetic::sum;
+  WeightedSum sum(const WeightedValue& term) const
+  {
+    return WeightedSum(term.weight * term.value * term.value, term.weight);
+  }
+};
+
+// order 2D grid with and without weight storage and ensure the orderings
+// agree, also for derived functionals, then ensure weights are stored again
+// when needed
+static std::string
+unit_test(
+  uint size // number of nodes along each dimension
+)
+{
+  // order grids
+  Graph graph;
+  Graph reference;
+  if (!graph.discard_weights() || !graph.unit_weights())
+    return std::string("cannot discard weights");
+  grid(graph, size);
+  grid(reference, size);
+  Functional* functional = new FunctionalGeometric();
+  graph.order(functional, 3, 4, 1, 1);
+  reference.order(functional, 3, 4, 1, 1);
+  Float cost = graph.cost();
+  Float mincost = reference.cost();
+  delete functional;
+  if (!graph.unit_weights())
+    return std::string("weights stored");
+  if (cost != mincost)
+    return stringize(cost) + " != " + stringize(mincost);
+  for (uint k = 0; k < size * size; k++)
+    if (graph.permutation(k) != reference.permutation(k))
+      return std::string("orderings differ");
+
+  // unit-weight terms of derived functionals are given by their sum()
+  functional = new FunctionalSquare();
+  WeightedSum s;
+  functional->accumulate(s, Float(3));
+  if (s.value != 9 || s.weight != 1)
+    return std::string("derived functional term ignored");
+  graph.order(functional, 3, 4, 1, 1);
+  reference.order(functional, 3, 4, 1, 1);
+  cost = graph.cost();
+  mincost = reference.cost();
+  delete functional;
+  if (cost != mincost)
+    return stringize(cost) + " != " + stringize(mincost) + " for derived functional";
+  for (uint k = 0; k < size * size; k++)
+    if (graph.permutation(k) != reference.permutation(k))
+      return std::string("orderings differ for derived functional");
+
+  // insert arcs with non-unit weight
+  Node::Index i = graph.insert_node();
+  Node::Index j = graph.insert_node();
+  graph.insert_arc(i, j, 2);
+  graph.insert_arc(j, i, 2);
+  if (graph.unit_weights() || graph.arc_weight(1) != 1 || graph.arc_weight(graph.arc_index(j, i)) != 2)
+    return std::string("incorrect weights");
+  if (graph.discard_weights())
+    return std::string("unequal weights discarded");
+
+  return std::string();
+}
+
+// order grid using different numbers of threads and ensure the orderings
+// agree
+static std::string
+threads_test(
+  uint size // number of nodes along each dimension
+)
+{
+  Graph graph;
+  Graph reference;
+  grid(graph, size);
+  grid(reference, size);
+  graph.set_threads(3);
+  reference.set_threads(1);
+  if (graph.threads() != 3)
+    return std::string("thread count not set");
+  Functional* functional = new FunctionalGeometric();
+  graph.order(functional, 3, 4, 1, 1);
+  reference.order(functional, 3, 4, 1, 1);
+  delete functional;
+  for (uint k = 0; k < size * size; k++)
+    if (graph.permutation(k) != reference.permutation(k))
+      return std::string("orderings differ");
+
+  return std::string();
+}
+
+// order grid using an ensemble of seeds and ensure the results match
+// ordering with each seed separately
+static std::string
+ensemble_test(
+  uint size // number of nodes along each dimension
+)
+{
+  std::vector<uint> seeds;
+  for (uint seed = 1; seed <= 4; seed++)
+    seeds.push_back(seed);
+  Functional* functional = new FunctionalGeometric();
+  Graph graph;
+  grid(graph, size);
+  std::vector<Float> costs;
+  uint best = graph.order(functional, seeds, costs, 2, 3, 1);
+  std::string error;
+  if (costs.size() != seeds.size())
+    error = "incorrect number of costs";
+  for (uint k = 0; k < seeds.size() && error.empty(); k++) {
+    Graph reference;
+    grid(reference, size);
+    reference.order(functional, 2, 3, 1, seeds[k]);
+    if (costs[k] != reference.cost())
+      error = stringize(costs[k]) + " != " + stringize(reference.cost());
+    else if (costs[k] < costs[best])
+      error = "ordering not best";
+    else if (k == best)
+      for (uint i = 0; i < size * size; i++)
+        if (graph.permutation(i) != reference.permutation(i))
+          error = "orderings differ";
+  }
+  if (error.empty() && graph.cost() != costs[best])
+    error = "incorrect cost";
+  delete functional;
+
+  return error;
+}
+
+// arithmetic mean, which derives from a built-in functional and is
+// therefore optimized by branch-and-bound over permutations
+class FunctionalLinear : public FunctionalArithmetic {};
+
+// minimum cost over all layouts of graph
+static Float
+mincost(const Graph& graph, const Functional* functional)
+{
+  std::vector<Node::Index> perm;
+  for (Node::Index i = 1; i <= graph.nodes(); i++)
+    perm.push_back(i);
+  std::vector<uint> rank(graph.nodes() + 1);
+  Float min = std::numeric_limits<Float>::max();
+  do {
+    for (uint k = 0; k < perm.size(); k++)
+      rank[perm[k]] = k;
+    WeightedSum c;
+    for (Node::Index i = 1; i <= graph.nodes(); i++)
+      for (Arc::Index a = graph.node_begin(i); a < graph.node_end(i); a++) {
+        Node::Index j = graph.arc_target(a);
+        Float l = Float(rank[i] > rank[j] ? rank[i] - rank[j] : rank[j] - rank[i]);
+        functional->accumulate(c, WeightedValue(l, graph.arc_weight(a)));
+      }
+    min = std::min(min, functional->mean(c));
+  } while (std::next_permutation(perm.begin(), perm.end()));
+  return min;
+}
+
+// order small random graphs using a single window that spans all nodes and
+// ensure the optimal cost is attained both by optimizing windows of the
+// arithmetic mean, which uses dynamic programming over subsets when
+// enabled, and of a derived functional, which uses branch-and-bound
+static std::string
+window_test(
+  uint maxnodes, // maximum number of nodes
+  uint trials    // number of graphs per node count
+)
+{
+  uint state = 1;
+  for (uint nodes = 3; nodes <= maxnodes; nodes++)
+    for (uint k = 0; k < trials; k++) {
+      // construct random graph with integer weights in [1, 4]
+      std::vector<Float> weight(nodes * nodes, 0);
+      for (uint i = 0; i < nodes; i++)
+        for (uint j = i + 1; j < nodes; j++) {
+          state = 0x1ed0675 * state + 0xa14f;
+          if (state & 0x100)
+            weight[i * nodes + j] = weight[j * nodes + i] = Float(1 + (state >> 9) % 4);
+        }
+      Graph graph(nodes);
+      for (Node::Index i = 1; i <= nodes; i++)
+        for (Node::Index j = 1; j <= nodes; j++)
+          if (weight[(i - 1) * nodes + (j - 1)] && !graph.insert_arc(i, j, weight[(i - 1) * nodes + (j - 1)]))
+            return std::string("arc insertion failed");
+      if (!graph.edges())
+        continue;
+
+      Functional* arithmetic = new FunctionalArithmetic();
+      Functional* linear = new FunctionalLinear();
+      Float min = mincost(graph, arithmetic);
+      graph.order(arithmetic, 1, nodes, 1, k + 1);
+      Float cost = graph.cost();
+      graph.order(linear, 1, nodes, 1, k + 1);
+      Float reference = graph.cost();
+      delete arithmetic;
+      delete linear;
+
+      Float epsilon = Float(1e-5);
+      if (std::fabs(cost - min) > epsilon * min)
+        return stringize(cost) + " != " + stringize(min) + " for " + stringize(nodes) + " nodes";
+      if (std::fabs(reference - min) > epsilon * min)
+        return stringize(reference) + " != " + stringize(min) + " for " + stringize(nodes) + " nodes using branch-and-bound";
+    }
+
+  return std::string();
+}
+
+// progress callbacks that record the work done after each V-cycle
+class ActivityLog : public Progress {
+public:
+  void enditer(const Graph* graph, Float, Float) const { activity.push_back(graph->activity()); }
+  mutable std::vector<Activity> activity;
+};
+
+// order grid and ensure the work done by each V-cycle is accounted for,
+// with nothing skipped in the first V-cycle, and counted afresh by the
+// next ordering
+static std::string
+activity_test(
+  uint size // number of nodes along each dimension
+)
+{
+  Graph graph;
+  grid(graph, size);
+  Functional* functional = new FunctionalGeometric();
+  ActivityLog log;
+  graph.order(functional, 4, 3, 1, 1, &log);
+  const std::vector<Activity>& a = log.activity;
+  std::string error;
+  if (a.size() != 4)
+    error = "incorrect number of V-cycles";
+  else if (!a[0].relaxed || !a[0].optimized)
+    error = "no work done";
+  else if (a[0].unrelaxed || a[0].unoptimized)
+    error = "work skipped in first V-cycle";
+  for (uint k = 1; k < a.size() && error.empty(); k++)
+    if (a[k].relaxed + a[k].unrelaxed <= a[k - 1].relaxed + a[k - 1].unrelaxed || a[k].optimized + a[k].unoptimized <= a[k - 1].optimized + a[k - 1].unoptimized)
+      error = "work not accumulated";
+  graph.order(functional, 0);
+  if (error.empty() && (graph.activity().relaxed || graph.activity().optimized))
+    error = "work not reset";
+  delete functional;
+
+  return error;
+}
+
 // report the result of a test and return 1 if it failed
 static int
 report(std::string test, std::string error, int columns = 20)
@@ -246,6 +902,56 @@ int main(int argc, char* argv[])
     tests++;
   }
 
+  // order grids constructed from compressed sparse row arrays
+  error = csr_test(16);
+  failures += report("csr test", error);
+  tests++;
+
+  // order hypercubes constructed from unordered edges
+  error = builder_test(maxdims);
+  failures += report("builder test", error);
+  tests++;
+
+  // remove edges in a single pass
+  error = removal_test(32);
+  failures += report("removal test", error);
+  tests++;
+
+  // order grid with shared edge weights
+  error = shared_test(5);
+  failures += report("shared weights test", error);
+  tests++;
+
+  // order grids with 16-, 32-, and 64-bit indices
+  error = index_test(24);
+  failures += report("index width test", error);
+  tests++;
+
+  // order grid without weight storage
+  error = unit_test(24);
+  failures += report("unit weights test", error);
+  tests++;
+
+  // order grid using multiple threads
+  error = threads_test(24);
+  failures += report("threads test", error);
+  tests++;
+
+  // order grid using multiple seeds
+  error = ensemble_test(16);
+  failures += report("ensemble test", error);
+  tests++;
+
+  // optimize small graphs exactly
+  error = window_test(8, 10);
+  failures += report("window test", error);
+  tests++;
+
+  // account for work done and skipped
+  error = activity_test(16);
+  failures += report("activity test", error);
+  tests++;
+
   // summarize tests
   return finish(failures, tests);
 }
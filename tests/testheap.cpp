@@ -0,0 +1,304 @@
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "gecko/types.h"
+#include "heap.h"
+
+using namespace Gecko;
+
+template <typename T>
+static std::string
+stringize(T val)
+{
+  std::ostringstream s;
+  s << val;
+  return s.str();
+}
+
+// linear congruential generator for reproducible tests
+static uint
+random(uint& state)
+{
+  state = 0x1ed0675 * state + 0xa14f;
+  return state >> 8;
+}
+
+// highest priority among queued data or -1 if none
+static int
+highest(const std::vector<bool>& queued, const std::vector<Float>& priority)
+{
+  int k = -1;
+  for (uint i = 0; i < queued.size(); i++)
+    if (queued[i] && (k < 0 || priority[i] > priority[k]))
+      k = int(i);
+  return k;
+}
+
+// perform random insertions, updates, erasures, and extractions on heap
+// and compare with a reference model
+template <class Heap>
+static std::string
+heap_check(Heap& heap, uint count, uint operations, uint state)
+{
+  std::vector<bool> queued(count, false);
+  std::vector<Float> priority(count, 0);
+  size_t size = 0;
+  for (uint k = 0; k < operations; k++) {
+    uint data = random(state) % count;
+    // include duplicate, zero, and negative priorities
+    Float p = Float(int(random(state) % 64) - 16);
+    switch (random(state) % 4) {
+      case 0: // insert or, if queued, update
+        heap.insert(data, p);
+        size += !queued[data];
+        queued[data] = true;
+        priority[data] = p;
+        break;
+      case 1: // update, which ignores data not queued
+        heap.update(data, p);
+        if (queued[data])
+          priority[data] = p;
+        break;
+      case 2: // erase
+        if (heap.erase(data) != queued[data])
+          return std::string("erase of ") + stringize(data) + " returned wrong status";
+        size -= queued[data];
+        queued[data] = false;
+        break;
+      case 3: { // extract
+        uint d;
+        Float q;
+        int i = highest(queued, priority);
+        if (heap.extract(d, q) != (i >= 0))
+          return std::string("extract returned wrong status");
+        if (i >= 0) {
+          if (!queued[d] || q != priority[d] || q != priority[i])
+            return std::string("extracted ") + stringize(q) + " rather than " + stringize(priority[i]);
+          queued[d] = false;
+          size--;
+        }
+        break;
+      }
+    }
+    if (heap.size() != size || heap.empty() != !size)
+      return std::string("incorrect heap size");
+    Float q;
+    if (heap.find(data, q) != queued[data] || (queued[data] && q != priority[data]))
+      return std::string("incorrect priority of ") + stringize(data);
+  }
+
+  // drain heap in order of nonincreasing priority
+  for (Float last = std::numeric_limits<Float>::max(); !heap.empty();) {
+    uint d;
+    Float q;
+    if (!heap.top(d, q) || !heap.extract(d) || q != priority[d] || q > last)
+      return std::string("heap not drained in order");
+    last = q;
+  }
+  uint d;
+  if (heap.top(d) || heap.pop() || heap.extract(d))
+    return std::string("empty heap not empty");
+
+  return std::string();
+}
+
+// exercise heap of given arity, then reuse it after clearing
+template <unsigned D>
+static std::string
+heap_test(uint count = 100)
+{
+  DynamicHeap<uint, Float, std::less<Float>, uint, DenseIndex<uint, uint>, D> heap(count);
+  std::string error = heap_check(heap, count, 20000, 1);
+  if (!error.empty())
+    return error;
+
+  // clear partially filled heap and ensure it is reusable
+  for (uint i = 0; i < count; i += 2)
+    heap.insert(i, Float(i));
+  heap.clear();
+  if (!heap.empty() || heap.size())
+    return std::string("cleared heap not empty");
+  for (uint i = 0; i < count; i++)
+    if (heap.find(i))
+      return std::string("cleared heap contains ") + stringize(i);
+  error = heap_check(heap, count, 20000, 2);
+  if (!error.empty())
+    return std::string("after clear: ") + error;
+
+  // data beyond reserved range grows the dense index
+  heap.insert(10 * count, 1);
+  if (!heap.find(10 * count) || heap.find(10 * count - 1))
+    return std::string("unreserved data not indexed");
+
+  return std::string();
+}
+
+// exercise heap with map index
+static std::string
+map_test(uint count = 100)
+{
+  DynamicHeap<uint, Float, std::less<Float>, uint, MapIndex<uint, uint> > heap;
+  return heap_check(heap, count, 20000, 3);
+}
+
+// ensure bucket queue extracts entries from the highest nonempty bucket,
+// including the buckets reserved for nonpositive, tiny, and huge priorities
+static std::string
+bucket_test(uint count = 100)
+{
+  const unsigned S = 4;
+  BucketQueue<uint, Float, S> queue(count);
+
+  // priorities in order of extraction, which are inserted in reverse order;
+  // the first two are clamped to the top bucket, the next two lie just
+  // inside the range of exponents, 1e-30 is clamped to the lowest bucket
+  // for positive priorities, and the last three share bucket zero, all of
+  // which are extracted last in, first out
+  const Float priority[] = {
+    std::numeric_limits<Float>::max(),
+    Float(1e30),
+    Float(1e18),
+    Float(2),
+    Float(1.75),
+    Float(1.5),
+    Float(1.25),
+    Float(1),
+    Float(0.5),
+    Float(1e-18),
+    Float(1e-30),
+    Float(0),
+    Float(-1),
+    -std::numeric_limits<Float>::max(),
+  };
+  const uint n = sizeof(priority) / sizeof(priority[0]);
+  for (uint k = 0; k < n; k++)
+    queue.insert((5 * k) % n, priority[n - 1 - k]);
+  if (queue.size() != n)
+    return std::string("incorrect queue size");
+  for (uint k = 0; k < n; k++) {
+    uint d;
+    Float p;
+    if (!queue.extract(d, p))
+      return std::string("queue empty after ") + stringize(k) + " extractions";
+    if (p != priority[k] || d != (5 * (n - 1 - k)) % n)
+      return std::string("extracted ") + stringize(p) + " rather than " + stringize(priority[k]);
+  }
+  if (!queue.empty())
+    return std::string("queue not empty");
+
+  // priorities within a bucket are extracted last in, first out, while
+  // those in adjacent buckets are extracted in order
+  queue.insert(1, Float(1.125));
+  queue.insert(2, Float(1));
+  queue.insert(3, Float(1) - std::numeric_limits<Float>::epsilon());
+  queue.insert(4, Float(1.25));
+  uint order[] = { 4, 2, 1, 3 };
+  for (uint k = 0; k < 4; k++) {
+    uint d;
+    if (!queue.extract(d) || d != order[k])
+      return std::string("incorrect order at bucket boundary");
+  }
+
+  // updates move entries between buckets
+  queue.insert(1, 1);
+  queue.insert(2, 2);
+  queue.update(1, 4);
+  queue.update(3, 8); // not queued
+  Float p;
+  if (queue.find(3) || !queue.find(1, p) || p != 4)
+    return std::string("incorrect update");
+  uint d;
+  if (!queue.extract(d) || d != 1 || !queue.extract(d) || d != 2)
+    return std::string("updated entry not moved");
+
+  // random operations extract an entry whose priority is within one bucket
+  // width of the highest priority
+  std::vector<bool> queued(count, false);
+  std::vector<Float> value(count, 0);
+  uint state = 4;
+  for (uint k = 0; k < 20000; k++) {
+    uint data = random(state) % count;
+    Float q = std::ldexp(Float(1 + random(state) % 1024), int(random(state) % 64) - 32);
+    if (random(state) % 3) {
+      queue.insert(data, q);
+      queued[data] = true;
+      value[data] = q;
+    }
+    else {
+      int i = highest(queued, value);
+      if (queue.extract(d, p) != (i >= 0))
+        return std::string("extract returned wrong status");
+      if (i >= 0) {
+        if (!queued[d] || p != value[d] || p * (1 + Float(1) / S) <= value[i])
+          return std::string("extracted ") + stringize(p) + " while " + stringize(value[i]) + " is queued";
+        queued[d] = false;
+      }
+    }
+  }
+
+  // clear and reuse queue
+  queue.clear();
+  if (!queue.empty() || queue.size())
+    return std::string("cleared queue not empty");
+  for (uint i = 0; i < count; i++)
+    if (queue.find(i))
+      return std::string("cleared queue contains ") + stringize(i);
+  queue.insert(7, 3);
+  queue.insert(8, 5);
+  if (queue.size() != 2 || !queue.extract(d) || d != 8 || !queue.extract(d) || d != 7 || queue.extract(d))
+    return std::string("cleared queue not reusable");
+
+  return std::string();
+}
+
+// summarize tests and return exit code
+static int
+finish(size_t failures, size_t tests)
+{
+  std::cerr << std::endl;
+  if (failures)
+    std::cerr << failures << " test" << (failures > 1 ? "s" : "") << " of " << tests << " failed" << std::endl;
+  else
+    std::cerr << "all tests passed" << std::endl;
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// report the result of a test and return 1 if it failed
+static int
+report(std::string test, std::string error, int columns = 20)
+{
+  std::cerr << std::setw(columns) << std::left << test << " ";
+  if (error.empty()) {
+    std::cerr << "[ OK ]" << std::endl;
+    return 0;
+  }
+  else {
+    std::cerr << "[FAIL] " << error << std::endl;
+    return 1;
+  }
+}
+
+int main()
+{
+  uint tests = 0;    // number of tests performed
+  uint failures = 0; // number of failed tests
+
+  failures += report("binary heap test", heap_test<2>());
+  tests++;
+  failures += report("4-ary heap test", heap_test<4>());
+  tests++;
+  failures += report("8-ary heap test", heap_test<8>());
+  tests++;
+  failures += report("map heap test", map_test());
+  tests++;
+  failures += report("bucket queue test", bucket_test());
+  tests++;
+
+  // summarize tests
+  return finish(failures, tests);
+}
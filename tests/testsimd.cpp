@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "gecko/functional.h"
+#include "options.h"
+#include "simd.h"
+
+using namespace Gecko;
+
+template <typename T>
+static std::string
+stringize(T val)
+{
+  std::ostringstream s;
+  s << val;
+  return s.str();
+}
+
+// linear congruential generator for reproducible tests
+static uint
+random(uint& state)
+{
+  state = 0x1ed0675 * state + 0xa14f;
+  return state >> 8;
+}
+
+// functional derived from a built-in one, which has no kernel
+class FunctionalDerived : public FunctionalArithmetic {};
+
+// scalar sum of terms with lengths x[j] - p > 0 for j in m, in node order
+static WeightedSum
+scalar(const Functional* f, const Float* x, const Float* w, Float p, uint m)
+{
+  WeightedSum s;
+  for (uint j = 0; j < GECKO_WINDOW_MAX; j++)
+    if ((m >> j) & 1u) {
+      Float l = x[j] - p;
+      if (l > 0)
+        f->accumulate(s, WeightedValue(l, w[j]));
+    }
+  return s;
+}
+
+// do a and b agree to within rounding?
+static bool
+agree(Float a, Float b)
+{
+  return std::fabs(a - b) <= Float(1e-5) * std::max(Float(1), std::max(std::fabs(a), std::fabs(b)));
+}
+
+// compare vectorized kernel of functional with scalar terms for each window
+// size, with masked-out entries, including the tail lanes beyond the window,
+// set to values that would change the result if included
+static std::string
+kernel_test(Functional* functional, bool exact = false)
+{
+  SimdKernel kernel = simd_kernel(functional);
+  if (!kernel)
+    return std::string("no kernel");
+  uint state = 1;
+  for (uint n = 1; n <= GECKO_WINDOW_MAX; n++)
+    for (uint k = 0; k < 200; k++) {
+      Float x[GECKO_WINDOW_MAX];
+      Float w[GECKO_WINDOW_MAX];
+      // node positions and weights within window; some nodes precede p
+      for (uint j = 0; j < n; j++) {
+        x[j] = Float(random(state) % 64) / 2 + Float(0.5);
+        w[j] = Float(1 + random(state) % 16) / 4;
+      }
+      // tail lanes hold finite values to be ignored
+      for (uint j = n; j < GECKO_WINDOW_MAX; j++) {
+        x[j] = Float(1e6) * Float(j + 1);
+        w[j] = Float(1e3);
+      }
+      Float p = Float(random(state) % 32) / 2;
+      // random subset of window nodes, including the full and empty sets
+      uint full = n < 32 ? (1u << n) - 1 : ~0u;
+      uint m = k == 0 ? full : k == 1 ? 0 : random(state) & full;
+      WeightedSum s(Float(random(state) % 8), Float(random(state) % 8));
+      WeightedSum t = s;
+      kernel(s, x, w, p, m);
+      functional->accumulate(t, scalar(functional, x, w, p, m));
+      if (exact ? s.value != t.value : !agree(s.value, t.value) || !agree(s.weight, t.weight))
+        return std::string("window size ") + stringize(n) + ", mask " + stringize(m) + ": " + stringize(s.value) + " != " + stringize(t.value);
+    }
+  return std::string();
+}
+
+// ensure only exact built-in functionals with vector terms have kernels
+static std::string
+selection_test()
+{
+  FunctionalGeometric geometric;
+  FunctionalDerived derived;
+  if (simd_kernel(&geometric))
+    return std::string("kernel for geometric mean");
+  if (simd_kernel(&derived))
+    return std::string("kernel for derived functional");
+  return std::string();
+}
+
+// summarize tests and return exit code
+static int
+finish(size_t failures, size_t tests)
+{
+  std::cerr << std::endl;
+  if (failures)
+    std::cerr << failures << " test" << (failures > 1 ? "s" : "") << " of " << tests << " failed" << std::endl;
+  else
+    std::cerr << "all tests passed" << std::endl;
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// report the result of a test and return 1 if it failed
+static int
+report(std::string test, std::string error, int columns = 20)
+{
+  std::cerr << std::setw(columns) << std::left << test << " ";
+  if (error.empty()) {
+    std::cerr << "[ OK ]" << std::endl;
+    return 0;
+  }
+  else {
+    std::cerr << "[FAIL] " << error << std::endl;
+    return 1;
+  }
+}
+
+int main()
+{
+  uint tests = 0;    // number of tests performed
+  uint failures = 0; // number of failed tests
+
+  FunctionalHarmonic harmonic;
+  FunctionalSMR smr;
+  FunctionalArithmetic arithmetic;
+  FunctionalRMS rms;
+  FunctionalMaximum maximum;
+
+  failures += report("harmonic kernel", kernel_test(&harmonic));
+  tests++;
+  failures += report("smr kernel", kernel_test(&smr));
+  tests++;
+  failures += report("arithmetic kernel", kernel_test(&arithmetic));
+  tests++;
+  failures += report("rms kernel", kernel_test(&rms));
+  tests++;
+  failures += report("maximum kernel", kernel_test(&maximum, true));
+  tests++;
+  failures += report("kernel selection", selection_test());
+  tests++;
+
+  // summarize tests
+  return finish(failures, tests);
+}
@@ -6,6 +6,7 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 #include "gecko.h"
 #include "gecko/graph.h"
 #include "gecko/drawing.h"
@@ -123,6 +124,10 @@ ChacoGraph::read(FILE* file)
         throw std::string("invalid first line in graph file");
     }
 
+    // avoid storing weights of unweighted graphs
+    if (!weighted)
+      discard_weights();
+
     // read nodes and their neighbors
     for (Node::Index i = 1; i <= nv; i++) {
       if (insert_node() != i) {
@@ -191,6 +196,7 @@ main(int argc, char *argv[])
   uint window = 2;            // initial window size
   uint period = 1;            // iterations between window increment
   uint seed = (uint)time(0);  // random number seed
+  uint seeds = 1;             // number of consecutive seeds to try
   FILE* psfile = 0;           // PostScript file
 
   // parse command-line arguments
@@ -201,8 +207,16 @@ main(int argc, char *argv[])
           throw std::string("cannot create PostScript file");
         /*FALLTHROUGH*/
       case 6:
-        if (sscanf(argv[5], "%u", &seed) != 1)
-          throw std::string("invalid seed");
+        switch (sscanf(argv[5], "%u:%u", &seed, &seeds)) {
+          case 1:
+            break;
+          case 2:
+            if (seeds)
+              break;
+            /*FALLTHROUGH*/
+          default:
+            throw std::string("invalid seed");
+        }
         /*FALLTHROUGH*/
       case 5:
         if (sscanf(argv[4], "%u", &period) != 1)
@@ -249,7 +263,7 @@ main(int argc, char *argv[])
   catch (std::string message) {
     if (!message.empty())
       std::cerr << "ERROR: " << message << std::endl;
-    std::cerr << "Usage: gecko <functional> [iterations [window [period [seed [psfile]]]]] <graph >permutation" << std::endl;
+    std::cerr << "Usage: gecko <functional> [iterations [window [period [seed[:count] [psfile]]]]] <graph >permutation" << std::endl;
     std::cerr << "Functionals:" << std::endl;
     std::cerr << "  h: harmonic mean" << std::endl;
     std::cerr << "  g: geometric mean" << std::endl;
@@ -275,8 +289,21 @@ main(int argc, char *argv[])
   MyProgress* progress = new MyProgress(drawing);
 
   // order graph
-  std::cerr << "s = " << seed << std::endl;
-  graph.order(functional, iterations, window, period, seed, progress);
+  if (seeds == 1) {
+    std::cerr << "s = " << seed << std::endl;
+    graph.order(functional, iterations, window, period, seed, progress);
+  }
+  else {
+    // order graph using consecutive seeds concurrently and keep the best
+    std::vector<uint> seed_list;
+    std::vector<Float> costs;
+    for (uint k = 0; k < seeds; k++)
+      seed_list.push_back(seed + k);
+    std::cerr << "s = " << seed << ":" << seeds << std::endl;
+    uint best = graph.order(functional, seed_list, costs, iterations, window, period, progress);
+    for (uint k = 0; k < seeds; k++)
+      std::cerr << "s = " << seed_list[k] << "  f = " << std::fixed << std::setprecision(6) << costs[k] << (k == best ? "  *" : "") << std::endl;
+  }
   delete functional;
 
   // close PostScript file